@@ -1,4 +1,5 @@
 #include "args.h"
+#include "utils.h"
 
 /**
  * @file args.c
@@ -11,9 +12,30 @@
  * The function iterates through the command-line arguments and handles the following options:
  * - `-r`: Enable recursion
  * - `-6`: Enable IPv6 mode
- * - `-x`: Perform a reverse query
- * - `-s`: Set the source address for the query
+ * - `-q`: Set query types (comma separated type names, they override `-6` and `-x`)
+ * - `-x`: Perform a reverse query (or a sweep of an address range)
+ * - `-s`: Set the source address for the query (up to MAX_SERVERS times)
  * - `-p`: Set the port number for the query
+ * - `-f`: Read names to be queried from a file (`-` for standard input)
+ * - `--tcp`: Send all queries over TCP
+ * - `--uring`: Use the io_uring transport for UDP queries
+ * - `--edns`: Advertise the UDP payload size by an EDNS(0) OPT record
+ * - `--retries`: Set the number of retransmissions of a query
+ * - `--timeout`: Set the timeout of the first transmission of a query
+ * - `--inflight`: Set the maximum number of outstanding queries
+ * - `-j`: Set the number of worker threads in batch mode
+ * - `--unordered`: Print results of worker threads as they come
+ * - `--no-cache`: Disable the response cache in batch mode
+ * - `--skip-nxdomain`: Do not print NXDOMAIN results in batch and sweep mode
+ * - `--format`: Set the output format (`text`, `jsonl` or `bin`)
+ * - `--pcap-out`: Record sent queries and received responses into a pcap file
+ * - `--pcap-in`: Print responses recorded in a pcap file (no server is contacted)
+ * - `--trace`: Resolve the target iteratively starting at root servers
+ * - `--root-hints`: Read addresses of root servers from a file
+ * - `--follow`: Follow CNAME chains of the target to its A and AAAA records
+ * - `--cache-file`: Use a persistent cache file shared by program invocations
+ * - `--listen`: Run as a caching forwarder listening on the address
+ * - `--listen-port`: Set the port number of the forwarder
  * The default port is set to 53 if not specified.
  *
  * The function returns an error code (args_err_t) to indicate the success or failure of the
@@ -42,11 +64,17 @@
   * - `E_PORT_MISS` if the port option is missing an associated value.
   * - `E_SRC_MISS` if the source address option is missing an associated value.
   * - `E_TGT_MISS` if the target address is not specified.
+  * - `E_FILE_MISS` if the file option is missing an associated value.
+  * - `E_VALUE_MISS` if an option is missing an associated value.
+  * - `E_VALUE_INV` if the value of an option is not valid.
   */
 args_err_t getopts(args_t* args, int argc, char** argv) {
 
-    // Set up default arguments
+    // Set up default arguments, numeric options are set once all arguments are parsed
+    // (unset values tell whether an option is repeated)
     strcpy(args->port, "53");
+    args->retries = -1;
+    strcpy(args->listen_port, "53");
 
     // Read program arguments
     for (int i = 1; i < argc; i++) {
@@ -62,11 +90,33 @@ args_err_t getopts(args_t* args, int argc, char** argv) {
         else if(strcmp(arg, "-h") == 0){
             printf(
                 "-r: Recursion Desired (Recursion Desired = 1), otherwise no recursion.\n"
-                "\b-x: Reverse query instead of direct query.\n"
+                "\b-x: Reverse query instead of direct query, a range (e.g. 10.20.0.0/16) sweeps all its addresses.\n"
                 "\b-6: Query type AAAA instead of the default A.\n"
-                "\b-s: IP address or domain name of the server to which the query should be sent.\n"
+                "\b-q type[,type...]: Query types (e.g. MX,TXT), every type is queried at the same time.\n"
+                "\b-s: IP address or domain name of the server to which the query should be sent, up to 8 servers.\n"
                 "\b-p port: The port number to send the query to, default 53.\n"
                 "\b-t: Enables testing mode (TTL is hidden).\n"
+                "\b--tcp: Send queries over TCP (truncated UDP responses are always retried over TCP).\n"
+                "\b--uring: Send and receive UDP queries by io_uring (falls back to sendmmsg/recvmmsg if not supported).\n"
+                "\b--edns size: Add an EDNS(0) OPT record advertising the UDP payload size (e.g. 1232).\n"
+                "\b--retries n: Number of retransmissions of an unanswered query, default 2.\n"
+                "\b--timeout ms: Timeout of the first transmission, doubled by every retransmission, default 1000.\n"
+                "\b-f file: Batch mode, read names to be queried from a file, one per line (- for stdin).\n"
+                "\b--inflight n: Maximum number of outstanding queries, default 1, the number of -q types with -q,\n"
+                "\b  256 in daemon and sweep mode, 2 with --follow (one host at a time).\n"
+                "\b-j n: Number of worker threads in batch mode, default 1.\n"
+                "\b--unordered: Print results of worker threads as they come instead of the input order.\n"
+                "\b--no-cache: Disable the response cache in batch mode.\n"
+                "\b--skip-nxdomain: Do not print NXDOMAIN results in batch and sweep mode.\n"
+                "\b--format text|jsonl|bin: Output format, JSON Lines or length-prefixed binary records, default text.\n"
+                "\b--pcap-out file: Record all sent queries and received responses into a pcap capture.\n"
+                "\b--pcap-in file: Print DNS responses of a pcap capture instead of sending queries.\n"
+                "\b--trace: Resolve the address iteratively from root servers (-s servers are the root hints).\n"
+                "\b--root-hints file: Root servers for --trace, addresses or A/AAAA records of named.root.\n"
+                "\b--follow: Look up A and AAAA records at once and follow CNAME chains to the addresses.\n"
+                "\b--cache-file path: Persistent cache file shared by program invocations.\n"
+                "\b--listen address: Daemon mode, forward queries received on the address to the server (implies -r).\n"
+                "\b--listen-port port: The port number of the daemon, default 53.\n"
                 "\b-h: Show this message.\n"
                 "\baddress: The address to be queried.");
             exit(0);
@@ -87,15 +137,42 @@ args_err_t getopts(args_t* args, int argc, char** argv) {
             args->reverse = 1;
         }
         else if (strcmp(arg, "-s") == 0) {
-            if (strlen(args->source_addr) != 0) {
-                return E_OPT_DOUBLE;
+            if (args->nservers == MAX_SERVERS) {
+                return E_SRC_MANY;
             }
 
             if (i + 1 >= argc) {
                 return E_SRC_MISS;
             }
 
-            strcpy(args->source_addr, argv[++i]);
+            strncpy(args->source_addr[args->nservers++], argv[++i], sizeof(args->source_addr[0]) - 1);
+        }
+        else if (strcmp(arg, "-q") == 0) {
+            if (args->nqtypes != 0) {
+                return E_OPT_DOUBLE;
+            }
+
+            if (i + 1 >= argc) {
+                return E_VALUE_MISS;
+            }
+
+            char types[256] = { 0 };
+            strncpy(types, argv[++i], sizeof(types) - 1);
+
+            // Comma separated list of type names
+            for (char* type = strtok(types, ","); type != NULL; type = strtok(NULL, ",")) {
+                unsigned short qtype = get_dns_type_value(type);
+
+                if (qtype == 0 || args->nqtypes == MAX_QTYPES) {
+                    return E_VALUE_INV;
+                }
+
+                args->qtypes[args->nqtypes++] = qtype;
+            }
+
+            if (args->nqtypes == 0) {
+                return E_VALUE_INV;
+            }
         }
         else if (strcmp(arg, "-p") == 0) {
             if (i + 1 >= argc) {
@@ -117,19 +194,275 @@ args_err_t getopts(args_t* args, int argc, char** argv) {
 
             args->test = 1;
         }
-        else if (i == argc - 1) {
-            strcpy(args->target_addr, arg);
+        else if (strcmp(arg, "-f") == 0) {
+            if (strlen(args->file) != 0) {
+                return E_OPT_DOUBLE;
+            }
+
+            if (i + 1 >= argc) {
+                return E_FILE_MISS;
+            }
+
+            strncpy(args->file, argv[++i], sizeof(args->file) - 1);
+        }
+        else if (strcmp(arg, "--tcp") == 0) {
+            if (args->tcp == 1) {
+                return E_OPT_DOUBLE;
+            }
+
+            args->tcp = 1;
+        }
+        else if (strcmp(arg, "--uring") == 0) {
+            if (args->uring == 1) {
+                return E_OPT_DOUBLE;
+            }
+
+            args->uring = 1;
+        }
+        else if (strcmp(arg, "--edns") == 0) {
+            if (args->edns != 0) {
+                return E_OPT_DOUBLE;
+            }
+
+            if (i + 1 >= argc) {
+                return E_VALUE_MISS;
+            }
+
+            char* end;
+            long edns = strtol(argv[++i], &end, 10);
+
+            if (*end != 0 || end == argv[i] || edns < 512 || edns > 65535) {
+                return E_VALUE_INV;
+            }
+
+            args->edns = edns;
+        }
+        else if (strcmp(arg, "--retries") == 0) {
+            if (args->retries != -1) {
+                return E_OPT_DOUBLE;
+            }
+
+            if (i + 1 >= argc) {
+                return E_VALUE_MISS;
+            }
+
+            char* end;
+            long retries = strtol(argv[++i], &end, 10);
+
+            if (*end != 0 || end == argv[i] || retries < 0 || retries > 10) {
+                return E_VALUE_INV;
+            }
+
+            args->retries = retries;
+        }
+        else if (strcmp(arg, "--timeout") == 0) {
+            if (args->timeout != 0) {
+                return E_OPT_DOUBLE;
+            }
+
+            if (i + 1 >= argc) {
+                return E_VALUE_MISS;
+            }
+
+            char* end;
+            long timeout = strtol(argv[++i], &end, 10);
+
+            if (*end != 0 || end == argv[i] || timeout <= 0 || timeout > 60000) {
+                return E_VALUE_INV;
+            }
+
+            args->timeout = timeout;
+        }
+        else if (strcmp(arg, "--inflight") == 0) {
+            if (args->inflight != 0) {
+                return E_OPT_DOUBLE;
+            }
+
+            if (i + 1 >= argc) {
+                return E_VALUE_MISS;
+            }
+
+            char* end;
+            long inflight = strtol(argv[++i], &end, 10);
+
+            if (*end != 0 || end == argv[i] || inflight <= 0 || inflight > 65535) {
+                return E_VALUE_INV;
+            }
+
+            args->inflight = inflight;
+        }
+        else if (strcmp(arg, "-j") == 0) {
+            if (args->jobs != 0) {
+                return E_OPT_DOUBLE;
+            }
+
+            if (i + 1 >= argc) {
+                return E_VALUE_MISS;
+            }
+
+            char* end;
+            long jobs = strtol(argv[++i], &end, 10);
+
+            if (*end != 0 || end == argv[i] || jobs <= 0 || jobs > 1024) {
+                return E_VALUE_INV;
+            }
+
+            args->jobs = jobs;
+        }
+        else if (strcmp(arg, "--unordered") == 0) {
+            if (args->unordered == 1) {
+                return E_OPT_DOUBLE;
+            }
+
+            args->unordered = 1;
+        }
+        else if (strcmp(arg, "--no-cache") == 0) {
+            if (args->no_cache == 1) {
+                return E_OPT_DOUBLE;
+            }
+
+            args->no_cache = 1;
+        }
+        else if (strcmp(arg, "--skip-nxdomain") == 0) {
+            if (args->skip_nxdomain == 1) {
+                return E_OPT_DOUBLE;
+            }
+
+            args->skip_nxdomain = 1;
+        }
+        else if (strcmp(arg, "--format") == 0) {
+            if (i + 1 >= argc) {
+                return E_VALUE_MISS;
+            }
+
+            const char* format = argv[++i];
+
+            if (strcmp(format, "text") == 0) {
+                args->format = FORMAT_TEXT;
+            }
+            else if (strcmp(format, "jsonl") == 0) {
+                args->format = FORMAT_JSONL;
+            }
+            else if (strcmp(format, "bin") == 0) {
+                args->format = FORMAT_BINARY;
+            }
+            else {
+                return E_VALUE_INV;
+            }
+        }
+        else if (strcmp(arg, "--pcap-out") == 0) {
+            if (strlen(args->pcap_out) != 0) {
+                return E_OPT_DOUBLE;
+            }
+
+            if (i + 1 >= argc) {
+                return E_VALUE_MISS;
+            }
+
+            strncpy(args->pcap_out, argv[++i], sizeof(args->pcap_out) - 1);
+        }
+        else if (strcmp(arg, "--pcap-in") == 0) {
+            if (strlen(args->pcap_in) != 0) {
+                return E_OPT_DOUBLE;
+            }
+
+            if (i + 1 >= argc) {
+                return E_VALUE_MISS;
+            }
+
+            strncpy(args->pcap_in, argv[++i], sizeof(args->pcap_in) - 1);
+        }
+        else if (strcmp(arg, "--trace") == 0) {
+            if (args->trace == 1) {
+                return E_OPT_DOUBLE;
+            }
+
+            args->trace = 1;
+        }
+        else if (strcmp(arg, "--root-hints") == 0) {
+            if (strlen(args->root_hints) != 0) {
+                return E_OPT_DOUBLE;
+            }
+
+            if (i + 1 >= argc) {
+                return E_VALUE_MISS;
+            }
+
+            strncpy(args->root_hints, argv[++i], sizeof(args->root_hints) - 1);
+        }
+        else if (strcmp(arg, "--follow") == 0) {
+            if (args->follow == 1) {
+                return E_OPT_DOUBLE;
+            }
+
+            args->follow = 1;
+        }
+        else if (strcmp(arg, "--cache-file") == 0) {
+            if (strlen(args->cache_file) != 0) {
+                return E_OPT_DOUBLE;
+            }
+
+            if (i + 1 >= argc) {
+                return E_VALUE_MISS;
+            }
+
+            strncpy(args->cache_file, argv[++i], sizeof(args->cache_file) - 1);
+        }
+        else if (strcmp(arg, "--listen") == 0) {
+            if (strlen(args->listen_addr) != 0) {
+                return E_OPT_DOUBLE;
+            }
+
+            if (i + 1 >= argc) {
+                return E_VALUE_MISS;
+            }
+
+            strncpy(args->listen_addr, argv[++i], sizeof(args->listen_addr) - 1);
+        }
+        else if (strcmp(arg, "--listen-port") == 0) {
+            if (i + 1 >= argc) {
+                return E_VALUE_MISS;
+            }
+
+            int port = atoi(argv[++i]);
+
+            if (port <= 0 || port > 65535) {
+                return E_VALUE_INV;
+            }
+
+            strcpy(args->listen_port, argv[i]);
+        }
+        else if (i == argc - 1 && strlen(args->file) == 0 && strlen(args->listen_addr) == 0) {
+            strncpy(args->target_addr, arg, sizeof(args->target_addr) - 1);
         }
         else {
             return E_UNKNOWN_OPT;
         }
     }
 
-    if (strlen(args->target_addr) == 0) {
+    if (args->retries == -1) {
+        args->retries = 2;
+    }
+
+    if (args->timeout == 0) {
+        args->timeout = 1000;
+    }
+
+    if (args->jobs == 0) {
+        args->jobs = 1;
+    }
+
+    // Recorded responses are printed without any server
+    if (strlen(args->pcap_in) != 0) {
+        return 0;
+    }
+
+    if (strlen(args->target_addr) == 0 && strlen(args->file) == 0 && strlen(args->listen_addr) == 0) {
         return E_TGT_MISS;
     }
 
-    if (strlen(args->source_addr) == 0) {
+    // Root hints replace servers
+    if (args->nservers == 0 && strlen(args->root_hints) == 0) {
         return E_SRC_MISS;
     }
 
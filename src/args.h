@@ -6,7 +6,7 @@
  * arguments and declares functions related to parsing and handling command-line arguments. It
  * includes a structure, `args_t`, that contains various options and arguments required for
  * configuring a DNS query, such as recursion, reverse query, IPv6 mode, port number, source
- * address, and target address.
+ * address, target address and an input file for batch mode.
  *
  * Additionally, the file declares the function `getopts`, which is responsible for parsing
  * and validating command-line arguments and populating the `args_t` structure. Any errors
@@ -21,14 +21,47 @@
 #include "error.h"
 #include "libs.h"
 
+#define MAX_SERVERS 8
+#define MAX_QTYPES 16
+
+// Output format of results
+typedef enum {
+    FORMAT_TEXT,
+    FORMAT_JSONL,
+    FORMAT_BINARY
+} format_t;
+
 typedef struct {
     int recursive;
     int reverse;
     int ipv6;
     int test;
+    int inflight;
+    int jobs;
+    int unordered;
+    int no_cache;
+    int skip_nxdomain;
+    int format;
+    int trace;
+    int follow;
+    int tcp;
+    int uring;
+    int edns;
+    int retries;
+    int timeout;
+    int nservers;
+    int nqtypes;
+    unsigned short qtypes[MAX_QTYPES];
     char port[256];
-    char source_addr[256];
+    char source_addr[MAX_SERVERS][256];
     char target_addr[256];
+    char file[256];
+    char cache_file[256];
+    char listen_addr[256];
+    char listen_port[256];
+    char pcap_out[256];
+    char pcap_in[256];
+    char root_hints[256];
 } args_t;
 
 args_err_t getopts(args_t* args, int argc, char** argv);
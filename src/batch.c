@@ -0,0 +1,748 @@
+/**
+ * @file batch.c
+ * @brief Batch Mode Implementation
+ *
+ * This C source file, "batch.c" contains the implementation of the batch mode. Names are read
+ * from the file specified by the `-f` option (or from standard input if `-` is used), one name
+ * per line. Empty lines and lines starting with `#` are ignored.
+ *
+ * Queries are sent by the asynchronous resolver (see resolver.h), so up to `--inflight` queries
+ * may be outstanding at the same time. Every query is tagged by a line `Query (N): name` followed either by the response in the
+ * standard output format or by an error message, so a single output stream can be processed
+ * by other tools. With `--format` results are written as JSON Lines or binary records instead
+ * (see output.h).
+ *
+ * @author Oleksandr Turytsia (xturyt00)
+ * @date October 18, 2023
+ */
+#include "batch.h"
+
+/**
+ * @brief Read the next name from the input.
+ *
+ * This function reads lines from the input until it finds a line containing a name. Leading and
+ * trailing whitespaces are removed, empty lines and comments (lines starting with `#`) are skipped.
+ * Lines that do not fit into the name buffer are replaced by an empty name, so the caller can
+ * report them.
+ *
+ * @param input Input stream.
+ * @param name Buffer of size MAX_NAME where the name will be stored.
+ * @return 1 if a name was read, 0 at the end of the input.
+ */
+int read_name(FILE* input, char* name) {
+    char line[MAX_LINE];
+
+    while (fgets(line, MAX_LINE, input) != NULL) {
+        size_t len = strlen(line);
+
+        // Line is longer than the buffer, skip the rest of it
+        if (len == MAX_LINE - 1 && line[len - 1] != '\n') {
+            int c;
+            while ((c = fgetc(input)) != EOF && c != '\n');
+            *name = 0;
+            return 1;
+        }
+
+        // Trim whitespaces
+        char* start = line;
+        while (isspace((unsigned char)*start)) {
+            start++;
+        }
+
+        char* end = start + strlen(start);
+        while (end > start && isspace((unsigned char)*(end - 1))) {
+            end--;
+        }
+        *end = 0;
+
+        // Skip empty lines and comments
+        if (*start == 0 || *start == '#') {
+            continue;
+        }
+
+        if (end - start >= MAX_NAME) {
+            *name = 0;
+        }
+        else {
+            strcpy(name, start);
+        }
+
+        return 1;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Print the result of a query.
+ *
+ * This function prints the query tag followed by the response or by an error message, in
+ * machine-readable formats the result is written as a single record instead.
+ * NXDOMAIN results are not printed (and not reported as errors) with `--skip-nxdomain`.
+ *
+ * @param batch Pointer to the batch state.
+ * @param query Query from the input.
+ * @param err Error code of the query (0 on success).
+ * @param packet Response packet.
+ * @param len Length of the response packet.
+ * @return Error code of the query (including response code errors).
+ */
+static int print_query(batch_t* batch, batch_query_t* query, int err, unsigned char* packet, int len) {
+    // NXDOMAIN results are left out if requested
+    if (!err && batch->args->skip_nxdomain && len >= (int)sizeof(dns_header_t) &&
+        ((dns_header_t*)packet)->rcode == RCODE_NAME_ERROR) {
+        return 0;
+    }
+
+    if (batch->out != NULL) {
+        return write_result(batch->out, batch->args->format, query->index, query->target, err, packet, len, batch->args->test);
+    }
+
+    printf("Query (%u): %s\n", query->index, query->target);
+
+    if (!err) {
+        err = print_response(packet, len, batch->args->test);
+    }
+
+    if (err) {
+        printf("Error: %s\n", get_error_message(err));
+    }
+
+    return err;
+}
+
+/**
+ * @brief Print the result of a finished query.
+ *
+ * Callback of the resolver in the single-threaded batch mode. The error code is stored in the
+ * batch state.
+ *
+ * @param resolver Pointer to the resolver.
+ * @param result Result of the query.
+ * @param data Query from the input (context owned by `run_batch`).
+ */
+static void print_result(resolver_t* resolver, resolver_result_t* result, void* data) {
+    batch_t* batch = resolver->data;
+    batch_query_t* query = data;
+
+    int err = print_query(batch, query, result->err, result->packet, result->len);
+    if (err) {
+        batch->result = err;
+    }
+
+    batch->free[batch->nfree++] = query;
+}
+
+/**
+ * @brief Allocate contexts for all outstanding queries of a resolver.
+ *
+ * Every outstanding query has a context with its target, contexts are allocated once for
+ * the whole window and reused by subsequent queries.
+ *
+ * @param batch Pointer to the batch state.
+ * @param window Maximum number of outstanding queries.
+ */
+static void init_contexts(batch_t* batch, int window) {
+    batch->contexts = malloc(window * sizeof(batch_query_t));
+    batch->targets = malloc(window * MAX_NAME);
+    batch->free = malloc(window * sizeof(batch_query_t*));
+    if (batch->contexts == NULL || batch->targets == NULL || batch->free == NULL) {
+        exit_error(E_EAI, strerror(errno));
+    }
+
+    for (int i = 0; i < window; i++) {
+        batch->contexts[i].target = batch->targets + i * MAX_NAME;
+        batch->free[batch->nfree++] = &batch->contexts[i];
+    }
+}
+
+/**
+ * @brief Free contexts of outstanding queries.
+ *
+ * @param batch Pointer to the batch state.
+ */
+static void free_contexts(batch_t* batch) {
+    free(batch->contexts);
+    free(batch->targets);
+    free(batch->free);
+}
+
+/**
+ * @brief Create the writer of machine-readable results.
+ *
+ * @param batch Pointer to the batch state.
+ * @param writer Writer to be initialized (unused in text format).
+ */
+static void open_output(batch_t* batch, writer_t* writer) {
+    if (batch->args->format == FORMAT_TEXT) {
+        return;
+    }
+
+    if (writer_init(writer, STDOUT_FILENO, WRITER_SIZE)) {
+        exit_error(E_EAI, strerror(errno));
+    }
+
+    batch->out = writer;
+}
+
+/**
+ * @brief Write out buffered results.
+ *
+ * @param batch Pointer to the batch state.
+ */
+static void flush_output(batch_t* batch) {
+    if (batch->out != NULL) {
+        writer_flush(batch->out);
+    }
+    else {
+        fflush(stdout);
+    }
+}
+
+/**
+ * @brief Resolve all names from the input file.
+ *
+ * This function resolves every name from the file specified by the `-f` option using the
+ * resolver shared with the rest of the program. Up to `--inflight` queries are outstanding at
+ * the same time and results are printed in the order in which the responses arrive. Errors of
+ * a single query do not terminate the program, they are reported in place of the response.
+ *
+ * @param args Pointer to the program's command-line arguments.
+ * @param resolver Pointer to the resolver.
+ * @return 0 if all queries succeeded, otherwise the error code of the last failed query.
+ */
+int run_batch(args_t* args, resolver_t* resolver) {
+    FILE* input = strcmp(args->file, "-") == 0 ? stdin : fopen(args->file, "r");
+    if (input == NULL) {
+        exit_error(E_FILE, get_error_message(E_FILE));
+    }
+
+    batch_t batch = { .args = args, .result = 0 };
+    resolver->data = &batch;
+
+    writer_t writer;
+    open_output(&batch, &writer);
+
+    int window = resolver->config.window;
+    init_contexts(&batch, window);
+
+    char target[MAX_NAME];
+    char name[MAX_NAME];
+    unsigned int index = 0;
+
+    // Every name is queried for all types, `next` is the type of the next query of the name
+    unsigned short qtypes[MAX_QTYPES];
+    int nqtypes = get_query_types(args, qtypes);
+    int next = 0;
+
+    while (1) {
+        // Keep the window full, the rest of the input is read later
+        while (resolver_pending(resolver) < window) {
+            if (next == 0) {
+                if (!read_name(input, target)) {
+                    break;
+                }
+
+                index++;
+                get_query_name(args, target, name);
+            }
+
+            batch_query_t* query = batch.free[--batch.nfree];
+            strcpy(query->target, target);
+            query->index = index;
+
+            resolver_submit(resolver, name, qtypes[next], print_result, query);
+            next = (next + 1) % nqtypes;
+        }
+
+        if (resolver_pending(resolver) == 0) {
+            break;
+        }
+
+        int err_code = resolver_run(resolver, -1);
+        if (err_code) {
+            writer_free(batch.out);
+            exit_error(err_code, get_error_message(err_code));
+        }
+    }
+
+    if (input != stdin) {
+        fclose(input);
+    }
+
+    free_contexts(&batch);
+    writer_free(batch.out);
+
+    return batch.result;
+}
+
+/**
+ * @brief Check whether the target is an address range to be swept (`-x` with a prefix length).
+ *
+ * @param args Pointer to the program's command-line arguments.
+ * @return 1 in sweep mode, 0 otherwise.
+ */
+int is_sweep(args_t* args) {
+    return args->reverse && strlen(args->file) == 0 && strchr(args->target_addr, '/') != NULL;
+}
+
+/**
+ * @brief Send reverse queries for every address of a range.
+ *
+ * Addresses of the range specified as the target (e.g. 10.20.0.0/16 or 2001:db8::/112) are
+ * enumerated in order, their reverse names are built directly from the binary address and up to
+ * `--inflight` queries are outstanding at the same time. Results are printed as in batch mode
+ * in the order in which the responses arrive, tagged by the address.
+ *
+ * @param args Pointer to the program's command-line arguments.
+ * @param resolver Pointer to the resolver.
+ * @return 0 if all queries succeeded, otherwise the error code of the last failed query.
+ */
+int run_sweep(args_t* args, resolver_t* resolver) {
+    cidr_t cidr;
+    if (parse_cidr(args->target_addr, &cidr)) {
+        exit_error(E_RANGE, get_error_message(E_RANGE));
+    }
+
+    batch_t batch = { .args = args, .result = 0 };
+    resolver->data = &batch;
+
+    writer_t writer;
+    open_output(&batch, &writer);
+
+    int window = resolver->config.window;
+    init_contexts(&batch, window);
+
+    char target[MAX_NAME];
+    char name[MAX_NAME];
+    unsigned char addr[sizeof(struct in6_addr)];
+    unsigned long long next = 0;
+
+    // Every address is queried for all types, `type` is the type of the next query of the address
+    unsigned short qtypes[MAX_QTYPES];
+    int nqtypes = get_query_types(args, qtypes);
+    int type = 0;
+
+    while (1) {
+        while (resolver_pending(resolver) < window && (type != 0 || next < cidr.count)) {
+            if (type == 0) {
+                get_cidr_address(&cidr, next++, addr);
+                inet_ntop(cidr.family, addr, target, MAX_NAME);
+
+                if (cidr.family == AF_INET) {
+                    reverse_dns_ipv4(name, addr);
+                }
+                else {
+                    reverse_dns_ipv6(name, addr);
+                }
+            }
+
+            batch_query_t* query = batch.free[--batch.nfree];
+            strcpy(query->target, target);
+            query->index = next;
+
+            resolver_submit(resolver, name, qtypes[type], print_result, query);
+            type = (type + 1) % nqtypes;
+        }
+
+        if (resolver_pending(resolver) == 0) {
+            break;
+        }
+
+        int err_code = resolver_run(resolver, -1);
+        if (err_code) {
+            writer_free(batch.out);
+            exit_error(err_code, get_error_message(err_code));
+        }
+    }
+
+    free_contexts(&batch);
+    writer_free(batch.out);
+
+    return batch.result;
+}
+
+/**
+ * @brief Store or print the result of a finished query.
+ *
+ * Callback of the resolver in the multi-threaded batch mode. In the ordered mode a copy of the
+ * response is stored, otherwise the result is printed immediately (output is serialized by
+ * a mutex). The main thread is notified in both cases, so it can release the query.
+ *
+ * @param resolver Pointer to the resolver of the worker.
+ * @param result Result of the query.
+ * @param data Query from the input.
+ */
+static void store_result(resolver_t* resolver, resolver_result_t* result, void* data) {
+    batch_t* batch = ((batch_worker_t*)resolver->data)->batch;
+    batch_query_t* query = data;
+
+    unsigned char* packet = NULL;
+    if (!batch->args->unordered && !result->err) {
+        packet = malloc(result->len);
+        if (packet == NULL) {
+            exit_error(E_EAI, strerror(errno));
+        }
+        memcpy(packet, result->packet, result->len);
+    }
+
+    pthread_mutex_lock(&batch->lock);
+
+    if (batch->args->unordered) {
+        int err = print_query(batch, query, result->err, result->packet, result->len);
+        if (err) {
+            batch->result = err;
+        }
+    }
+
+    query->err = result->err;
+    query->packet = packet;
+    query->len = result->len;
+    query->done = 1;
+
+    pthread_cond_signal(&batch->done);
+    pthread_mutex_unlock(&batch->lock);
+}
+
+/**
+ * @brief Stop all threads of the multi-threaded batch mode after a failure of a worker.
+ *
+ * Only the first error is kept, it is reported by the main thread once workers are joined.
+ *
+ * @param batch Pointer to the batch state.
+ * @param err Error code of the failure.
+ */
+static void stop_batch(batch_t* batch, int err) {
+    int saved_errno = errno;
+
+    pthread_mutex_lock(&batch->lock);
+
+    if (!batch->stop) {
+        batch->stop = 1;
+        batch->err = err;
+        batch->err_errno = saved_errno;
+    }
+
+    pthread_cond_broadcast(&batch->done);
+    pthread_cond_broadcast(&batch->ready);
+    pthread_cond_broadcast(&batch->space);
+    pthread_mutex_unlock(&batch->lock);
+}
+
+/**
+ * @brief Reader thread of the multi-threaded batch mode.
+ *
+ * Names are read from the input into the ring of queries, one query per name and type. The reader
+ * waits while the ring is full, so at most `capacity` queries are read ahead of the oldest query
+ * that is not printed yet.
+ *
+ * @param arg Pointer to the batch state.
+ * @return NULL
+ */
+static void* run_reader(void* arg) {
+    batch_t* batch = arg;
+
+    unsigned short qtypes[MAX_QTYPES];
+    int nqtypes = get_query_types(batch->args, qtypes);
+
+    char target[MAX_NAME];
+    unsigned int index = 0;
+
+    while (read_name(batch->input, target)) {
+        index++;
+
+        for (int i = 0; i < nqtypes; i++) {
+            pthread_mutex_lock(&batch->lock);
+
+            while (!batch->stop && batch->head - batch->tail == (unsigned long long)batch->capacity) {
+                pthread_cond_wait(&batch->space, &batch->lock);
+            }
+
+            if (batch->stop) {
+                pthread_mutex_unlock(&batch->lock);
+                return NULL;
+            }
+
+            batch_query_t* query = &batch->queries[batch->head % batch->capacity];
+            query->index = index;
+            query->qtype = qtypes[i];
+            query->done = 0;
+            query->packet = NULL;
+            strcpy(query->target, target);
+            batch->head++;
+
+            pthread_cond_signal(&batch->ready);
+            pthread_cond_signal(&batch->done);
+            pthread_mutex_unlock(&batch->lock);
+        }
+    }
+
+    pthread_mutex_lock(&batch->lock);
+    batch->eof = 1;
+    pthread_cond_broadcast(&batch->ready);
+    pthread_cond_signal(&batch->done);
+    pthread_mutex_unlock(&batch->lock);
+
+    return NULL;
+}
+
+/**
+ * @brief Worker thread of the multi-threaded batch mode.
+ *
+ * Every worker is pinned to a core and has its own resolver (and therefore its own socket and
+ * event loop). Workers take queries from the ring in the input order, as long as their window
+ * is not full. Failures are recorded by `stop_batch` instead of terminating the process.
+ *
+ * @param arg Pointer to the worker.
+ * @return NULL
+ */
+static void* run_worker(void* arg) {
+    batch_worker_t* worker = arg;
+    batch_t* batch = worker->batch;
+
+    // Pin the worker to a core
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    if (cores > 0) {
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        CPU_SET(worker->index % cores, &cpus);
+        pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpus);
+    }
+
+    resolver_t resolver;
+    int err_code = setup_resolver(&resolver, batch->args, batch->servers, batch->cache, batch->capture);
+    if (err_code) {
+        stop_batch(batch, err_code);
+        return NULL;
+    }
+    resolver.data = worker;
+
+    char name[MAX_NAME];
+    int more = 1;
+
+    while (1) {
+        while (resolver_pending(&resolver) < resolver.config.window) {
+            pthread_mutex_lock(&batch->lock);
+
+            // Idle worker waits for the input
+            while (!batch->stop && batch->taken == batch->head && !batch->eof && resolver_pending(&resolver) == 0) {
+                pthread_cond_wait(&batch->ready, &batch->lock);
+            }
+
+            batch_query_t* query = NULL;
+            if (!batch->stop && batch->taken < batch->head) {
+                query = &batch->queries[batch->taken++ % batch->capacity];
+            }
+            more = !batch->eof;
+            int stop = batch->stop;
+
+            pthread_mutex_unlock(&batch->lock);
+
+            if (stop) {
+                resolver_free(&resolver);
+                return NULL;
+            }
+
+            if (query == NULL) {
+                break;
+            }
+
+            // Callback may be called by the submit, so the lock is not held
+            get_query_name(batch->args, query->target, name);
+            resolver_submit(&resolver, name, query->qtype, store_result, query);
+        }
+
+        if (resolver_pending(&resolver) == 0) {
+            break;
+        }
+
+        // Queries read in the meantime are taken after a short wait
+        err_code = resolver_run(&resolver, more && resolver_pending(&resolver) < resolver.config.window ? BATCH_POLL : -1);
+        if (err_code) {
+            stop_batch(batch, err_code);
+            break;
+        }
+    }
+
+    resolver_free(&resolver);
+
+    return NULL;
+}
+
+/**
+ * @brief Resolve all names from the input file by multiple worker threads.
+ *
+ * The input is read by a reader thread into a bounded ring of queries, `-j` workers take queries
+ * from the ring as their windows allow, so the output starts before the whole input is read.
+ * Results are printed in the input order by the main thread, or immediately by workers if
+ * `--unordered` is specified. The ring is also the reorder window, a slow query holds back at
+ * most `capacity` queries.
+ *
+ * @param args Pointer to the program's command-line arguments.
+ * @param servers Resolved DNS servers (one per `-s` option).
+ * @param cache Pointer to the response cache shared by workers (NULL if disabled).
+ * @param capture Pointer to the capture shared by workers (NULL if disabled).
+ * @return 0 if all queries succeeded, otherwise the error code of the last failed query.
+ */
+int run_parallel_batch(args_t* args, dns_server_t* servers, cache_t* cache, capture_t* capture) {
+    FILE* input = strcmp(args->file, "-") == 0 ? stdin : fopen(args->file, "r");
+    if (input == NULL) {
+        exit_error(E_FILE, get_error_message(E_FILE));
+    }
+
+    batch_t batch = { .args = args, .servers = servers, .cache = cache, .capture = capture, .input = input, .result = 0 };
+    pthread_mutex_init(&batch.lock, NULL);
+    pthread_cond_init(&batch.done, NULL);
+    pthread_cond_init(&batch.ready, NULL);
+    pthread_cond_init(&batch.space, NULL);
+
+    writer_t writer;
+    open_output(&batch, &writer);
+
+    // Ring holds a few windows of every worker
+    long long capacity = (long long)args->jobs * get_window(args) * REORDER_FACTOR;
+    batch.capacity = capacity < MAX_REORDER ? capacity : MAX_REORDER;
+
+    batch.queries = calloc(batch.capacity, sizeof(batch_query_t));
+    batch.targets = malloc((size_t)batch.capacity * MAX_NAME);
+    batch_worker_t* workers = calloc(args->jobs, sizeof(batch_worker_t));
+    if (batch.queries == NULL || batch.targets == NULL || workers == NULL) {
+        exit_error(E_EAI, strerror(errno));
+    }
+
+    for (int i = 0; i < batch.capacity; i++) {
+        batch.queries[i].target = batch.targets + (size_t)i * MAX_NAME;
+    }
+
+    pthread_t reader;
+    if (pthread_create(&reader, NULL, run_reader, &batch)) {
+        exit_error(E_EAI, strerror(errno));
+    }
+
+    for (int i = 0; i < args->jobs; i++) {
+        workers[i].batch = &batch;
+        workers[i].index = i;
+
+        if (pthread_create(&workers[i].thread, NULL, run_worker, &workers[i])) {
+            exit_error(E_EAI, strerror(errno));
+        }
+    }
+
+    // Release finished queries in the input order, results are printed here unless `--unordered`
+    unsigned long long flushed = 0;
+    pthread_mutex_lock(&batch.lock);
+
+    while (!batch.stop) {
+        batch_query_t* query = &batch.queries[batch.tail % batch.capacity];
+
+        if (batch.tail == batch.head ? !batch.eof : !query->done) {
+            // Results are written out before waiting, so a slow input is answered as it comes
+            if (flushed != batch.tail) {
+                flush_output(&batch);
+                flushed = batch.tail;
+            }
+
+            pthread_cond_wait(&batch.done, &batch.lock);
+            continue;
+        }
+
+        if (batch.tail == batch.head) {
+            break;
+        }
+
+        pthread_mutex_unlock(&batch.lock);
+
+        if (!args->unordered) {
+            int err = print_query(&batch, query, query->err, query->packet, query->len);
+            if (err) {
+                batch.result = err;
+            }
+        }
+
+        free(query->packet);
+
+        pthread_mutex_lock(&batch.lock);
+        batch.tail++;
+        pthread_cond_signal(&batch.space);
+    }
+
+    pthread_mutex_unlock(&batch.lock);
+
+    for (int i = 0; i < args->jobs; i++) {
+        pthread_join(workers[i].thread, NULL);
+    }
+
+    // Reader may be blocked on the input, the process is terminated without joining it
+    if (batch.stop) {
+        writer_free(batch.out);
+        exit_error(batch.err, batch.err == E_EAI ? strerror(batch.err_errno) : get_error_message(batch.err));
+    }
+
+    pthread_join(reader, NULL);
+
+    if (input != stdin) {
+        fclose(input);
+    }
+
+    free(batch.queries);
+    free(batch.targets);
+    free(workers);
+    writer_free(batch.out);
+    pthread_mutex_destroy(&batch.lock);
+    pthread_cond_destroy(&batch.done);
+    pthread_cond_destroy(&batch.ready);
+    pthread_cond_destroy(&batch.space);
+
+    return batch.result;
+}
+
+/**
+ * @brief Print responses recorded in a pcap capture.
+ *
+ * Every DNS response of the capture specified by the `--pcap-in` option (queries are skipped) is
+ * printed as in batch mode, tagged by its position in the capture and the name of its question.
+ * Messages are parsed directly from the mapped file, so the output of a capture is reproducible
+ * and does not depend on any server.
+ *
+ * @param args Pointer to the program's command-line arguments.
+ * @return 0 if all responses were printed, otherwise the error code of the last failed response.
+ */
+int run_replay(args_t* args) {
+    capture_reader_t reader;
+    if (capture_reader_open(&reader, args->pcap_in)) {
+        exit_error(E_CAPTURE_FILE, get_error_message(E_CAPTURE_FILE));
+    }
+
+    batch_t batch = { .args = args, .result = 0 };
+
+    writer_t writer;
+    open_output(&batch, &writer);
+
+    char target[MAX_NAME];
+    batch_query_t query = { .index = 0, .target = target };
+    unsigned char* packet;
+    int len;
+
+    while (capture_next(&reader, &packet, &len)) {
+        if (len < (int)sizeof(dns_header_t) || !((dns_header_t*)packet)->qr) {
+            continue;
+        }
+
+        if (ntohs(((dns_header_t*)packet)->qdcount) == 0 ||
+            parse_domain_name(packet, len, sizeof(dns_header_t), target) == -1) {
+            target[0] = 0;
+        }
+
+        query.index++;
+
+        int err = print_query(&batch, &query, 0, packet, len);
+        if (err) {
+            batch.result = err;
+        }
+    }
+
+    writer_free(batch.out);
+    capture_reader_close(&reader);
+
+    return batch.result;
+}
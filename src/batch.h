@@ -0,0 +1,82 @@
+/**
+ * @file batch.h
+ * @brief Batch Mode Header
+ *
+ * This C header file, "batch.h" declares functions for the batch mode of the DNS query utility.
+ * In batch mode names are read from a file (or standard input), one per line, and resolved one
+ * after another by a single process, that reuses the resolved server address and the socket.
+ * In sweep mode PTR queries are generated for every address of a range. In replay mode responses
+ * recorded in a pcap capture are printed without contacting any server.
+ *
+ * @author Oleksandr Turytsia (xturyt00)
+ * @date October 18, 2023
+ */
+#ifndef BATCH_H
+#define BATCH_H
+
+#include "dns.h"
+#include "resolver.h"
+#include "output.h"
+
+#define MAX_LINE 1024
+#define SWEEP_WINDOW 256
+#define REORDER_FACTOR 4
+#define MAX_REORDER 65536
+#define BATCH_POLL 10
+
+// Query from the input
+typedef struct {
+    unsigned int index;             // Index of the query in the input (starting from 1)
+    char* target;                   // Name as specified in the input
+    unsigned short qtype;           // Type of the query (multi-threaded mode)
+    int done;                       // Query is finished (multi-threaded mode)
+    int err;                        // Error code of the finished query
+    unsigned char* packet;          // Copy of the response
+    int len;                        // Length of the response
+} batch_query_t;
+
+// State of the batch mode
+typedef struct {
+    args_t* args;                   // Program arguments
+    dns_server_t* servers;          // Servers where queries are sent
+    cache_t* cache;                 // Response cache shared by workers (NULL if disabled)
+    capture_t* capture;             // Capture shared by workers (NULL if disabled)
+    int result;                     // Error code of the last failed query
+    writer_t* out;                  // Writer of machine-readable results (NULL in text format)
+
+    batch_query_t* contexts;        // Contexts of outstanding queries (single-threaded mode)
+    char* targets;                  // Targets of the contexts or of the ring (MAX_NAME bytes each)
+    batch_query_t** free;           // Contexts of finished queries
+    int nfree;                      // Number of free contexts
+
+    FILE* input;                    // Input of names (multi-threaded mode)
+    batch_query_t* queries;         // Ring of queries read from the input (multi-threaded mode)
+    int capacity;                   // Number of queries in the ring (reorder window)
+    unsigned long long head;        // Sequence number of the next query read from the input
+    unsigned long long taken;       // Sequence number of the next query taken by a worker
+    unsigned long long tail;        // Sequence number of the oldest query in the ring
+    int eof;                        // Whole input was read
+    int stop;                       // Worker failed, all threads stop
+    int err;                        // Error code of the failed worker
+    int err_errno;                  // errno of the failed worker (for E_EAI)
+    pthread_mutex_t lock;           // Lock of the ring, results and output
+    pthread_cond_t done;            // Signaled when a query is finished, read or a worker failed
+    pthread_cond_t ready;           // Signaled when a query is read from the input
+    pthread_cond_t space;           // Signaled when a query leaves the ring
+} batch_t;
+
+// Worker thread of the multi-threaded batch mode
+typedef struct {
+    batch_t* batch;                 // Shared batch state
+    int index;                      // Index of the worker
+    pthread_t thread;               // Thread of the worker
+} batch_worker_t;
+
+int read_name(FILE* input, char* name);
+int run_batch(args_t* args, resolver_t* resolver);
+int run_sweep(args_t* args, resolver_t* resolver);
+int is_sweep(args_t* args);
+int run_parallel_batch(args_t* args, dns_server_t* servers, cache_t* cache, capture_t* capture);
+int run_replay(args_t* args);
+
+#endif
@@ -0,0 +1,380 @@
+/**
+ * @file cache.c
+ * @brief Response Cache Implementation
+ *
+ * This C source file, "cache.c" contains the implementation of the in-memory response cache.
+ * Entries are kept in a hash table with chaining and in a LRU list, the least recently used
+ * entry is evicted when the cache is full. Expired entries are removed when they are looked up.
+ *
+ * TTL values of records in a cached packet are decreased by the age of the entry when it is
+ * returned, so the output shows the remaining TTL as a recursive server would.
+ *
+ * If a cache file is attached (see cachefile.h), it is used as a second level of the cache,
+ * that is shared with other processes.
+ *
+ * @author Oleksandr Turytsia (xturyt00)
+ * @date October 18, 2023
+ */
+#include "cache.h"
+
+/**
+ * @brief Get the current time in seconds (CLOCK_MONOTONIC).
+ *
+ * @return Current time in seconds.
+ */
+static long long now_sec(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return now.tv_sec;
+}
+
+/**
+ * @brief Normalize a name for use as a key (lowercase, without the trailing dot).
+ *
+ * @param dest Buffer of size MAX_NAME for the normalized name.
+ * @param name Name to be normalized.
+ */
+void normalize_cache_key(char* dest, const char* name) {
+    int i;
+
+    for (i = 0; name[i] != 0 && i < MAX_NAME - 1; i++) {
+        dest[i] = tolower((unsigned char)name[i]);
+    }
+
+    if (i > 1 && dest[i - 1] == '.') {
+        i--;
+    }
+
+    dest[i] = 0;
+}
+
+/**
+ * @brief Compute the FNV-1a hash of a key.
+ *
+ * @param name Normalized name.
+ * @param qtype Type of the query.
+ * @param qclass Class of the query.
+ * @return Hash of the key.
+ */
+unsigned int hash_cache_key(const char* name, unsigned short qtype, unsigned short qclass) {
+    unsigned int hash = 2166136261u;
+
+    for (; *name != 0; name++) {
+        hash = (hash ^ (unsigned char)*name) * 16777619u;
+    }
+
+    hash = (hash ^ qtype) * 16777619u;
+    hash = (hash ^ qclass) * 16777619u;
+
+    return hash;
+}
+
+/**
+ * @brief Get the time for which a response may be cached.
+ *
+ * Positive responses are cached for the minimum TTL of their answer and authority records.
+ * Negative responses (NXDOMAIN, or NOERROR without answers) are cached for the minimum of the
+ * SOA record TTL and its MINIMUM field. Truncated responses, referrals, errors and malformed
+ * packets are not cached.
+ *
+ * @param packet DNS response packet.
+ * @param len Length of the packet.
+ * @return TTL in seconds, or -1 if the response must not be cached.
+ */
+int get_response_ttl(unsigned char* packet, int len) {
+    if (len < (int)sizeof(dns_header_t)) {
+        return -1;
+    }
+
+    dns_header_t* header = (dns_header_t*)packet;
+
+    if (header->tc || (header->rcode != 0 && header->rcode != RCODE_NAME_ERROR)) {
+        return -1;
+    }
+
+    dns_message_t message;
+    if (parse_message(&message, packet, len)) {
+        return -1;
+    }
+
+    int negative = header->rcode == RCODE_NAME_ERROR || message.counts[SECTION_ANSWER] == 0;
+    long long ttl = -1;
+
+    for (int i = 0; i < message.nrecords; i++) {
+        dns_record_t* record = &message.records[i];
+        long long rr_ttl = record->ttl;
+
+        if (record->section == SECTION_ADDITIONAL) {
+            break;
+        }
+
+        if (negative) {
+            if (record->section != SECTION_AUTHORITY || record->type != SOA || record->rdlength < sizeof(dns_soa_t)) {
+                continue;
+            }
+
+            // SOA MINIMUM is the last field of the RDATA
+            dns_soa_t* soa = (dns_soa_t*)(packet + record->rdata + record->rdlength - sizeof(dns_soa_t));
+            long long min_ttl = ntohl(soa->min_ttl);
+            rr_ttl = min_ttl < rr_ttl ? min_ttl : rr_ttl;
+        }
+
+        ttl = ttl == -1 || rr_ttl < ttl ? rr_ttl : ttl;
+    }
+
+    return (int)ttl;
+}
+
+/**
+ * @brief Decrease TTL values of all records in a packet.
+ *
+ * @param packet DNS packet.
+ * @param len Length of the packet.
+ * @param age Number of seconds to be subtracted.
+ */
+void age_response(unsigned char* packet, int len, long long age) {
+    dns_message_t message;
+    if (parse_message(&message, packet, len)) {
+        return;
+    }
+
+    for (int i = 0; i < message.nrecords; i++) {
+        dns_record_t* record = &message.records[i];
+
+        // TTL field of the OPT pseudo-record holds flags
+        if (record->type == OPT) {
+            continue;
+        }
+
+        // TTL is followed by RDLENGTH right before the RDATA
+        dns_rr_t* rr = (dns_rr_t*)(packet + record->rdata - sizeof(dns_rr_t));
+        rr->ttl = htonl(record->ttl > age ? record->ttl - age : 0);
+    }
+}
+
+/**
+ * @brief Unlink an entry from the LRU list.
+ */
+static void lru_unlink(cache_t* cache, cache_entry_t* entry) {
+    if (entry->lru_prev != NULL) {
+        entry->lru_prev->lru_next = entry->lru_next;
+    }
+    else {
+        cache->lru_head = entry->lru_next;
+    }
+
+    if (entry->lru_next != NULL) {
+        entry->lru_next->lru_prev = entry->lru_prev;
+    }
+    else {
+        cache->lru_tail = entry->lru_prev;
+    }
+}
+
+/**
+ * @brief Insert an entry at the head of the LRU list.
+ */
+static void lru_push(cache_t* cache, cache_entry_t* entry) {
+    entry->lru_prev = NULL;
+    entry->lru_next = cache->lru_head;
+
+    if (cache->lru_head != NULL) {
+        cache->lru_head->lru_prev = entry;
+    }
+    else {
+        cache->lru_tail = entry;
+    }
+
+    cache->lru_head = entry;
+}
+
+/**
+ * @brief Remove an entry from the cache and free it.
+ */
+static void remove_entry(cache_t* cache, cache_entry_t* entry) {
+    cache_entry_t** link = &cache->buckets[entry->hash & (cache->nbuckets - 1)];
+
+    while (*link != entry) {
+        link = &(*link)->next;
+    }
+    *link = entry->next;
+
+    lru_unlink(cache, entry);
+    cache->count--;
+
+    free(entry->packet);
+    free(entry);
+}
+
+/**
+ * @brief Find an entry in the cache (the cache must be locked).
+ */
+static cache_entry_t* find_entry(cache_t* cache, const char* name, unsigned short qtype, unsigned short qclass, unsigned int hash) {
+    for (cache_entry_t* entry = cache->buckets[hash & (cache->nbuckets - 1)]; entry != NULL; entry = entry->next) {
+        if (entry->hash == hash && entry->qtype == qtype && entry->qclass == qclass && strcmp(entry->name, name) == 0) {
+            return entry;
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief Initialize the cache.
+ *
+ * @param cache Pointer to the cache.
+ * @param capacity Maximum number of entries (0 if only the cache file is used).
+ * @return 0 on success, -1 if memory could not be allocated.
+ */
+int cache_init(cache_t* cache, int capacity) {
+    memset(cache, 0, sizeof(cache_t));
+
+    cache->capacity = capacity;
+    cache->file = NULL;
+    cache->nbuckets = 1;
+    while (cache->nbuckets < capacity) {
+        cache->nbuckets <<= 1;
+    }
+
+    cache->buckets = calloc(cache->nbuckets, sizeof(cache_entry_t*));
+    if (cache->buckets == NULL) {
+        return -1;
+    }
+
+    pthread_mutex_init(&cache->lock, NULL);
+
+    return 0;
+}
+
+/**
+ * @brief Look up a response in the cache.
+ *
+ * The response is copied into the packet buffer and TTL values of its records are decreased by
+ * the age of the entry. Identifier of the packet is left as it was stored.
+ *
+ * @param cache Pointer to the cache.
+ * @param name Queried name.
+ * @param qtype Type of the query.
+ * @param qclass Class of the query.
+ * @param packet Buffer of size MAX_BUFF for the response.
+ * @return Length of the response, or -1 if there is no valid entry.
+ */
+int cache_lookup(cache_t* cache, const char* name, unsigned short qtype, unsigned short qclass, unsigned char* packet) {
+    char key[MAX_NAME];
+    normalize_cache_key(key, name);
+    unsigned int hash = hash_cache_key(key, qtype, qclass);
+
+    pthread_mutex_lock(&cache->lock);
+
+    cache_entry_t* entry = find_entry(cache, key, qtype, qclass, hash);
+    long long now = now_sec();
+    int len = -1;
+
+    if (entry != NULL && entry->expires <= now) {
+        remove_entry(cache, entry);
+    }
+    else if (entry != NULL) {
+        lru_unlink(cache, entry);
+        lru_push(cache, entry);
+
+        len = entry->len;
+        memcpy(packet, entry->packet, len);
+        age_response(packet, len, now - entry->stored);
+    }
+
+    pthread_mutex_unlock(&cache->lock);
+
+    if (len == -1 && cache->file != NULL) {
+        len = cache_file_lookup(cache->file, name, qtype, qclass, packet);
+    }
+
+    return len;
+}
+
+/**
+ * @brief Store a response in the cache.
+ *
+ * Responses that must not be cached (see `get_response_ttl`) or have zero TTL are ignored.
+ * The response is also stored in the cache file if it is attached.
+ *
+ * @param cache Pointer to the cache.
+ * @param name Queried name.
+ * @param qtype Type of the query.
+ * @param qclass Class of the query.
+ * @param packet Response packet.
+ * @param len Length of the response.
+ */
+void cache_store(cache_t* cache, const char* name, unsigned short qtype, unsigned short qclass, unsigned char* packet, int len) {
+    int ttl = get_response_ttl(packet, len);
+    if (ttl <= 0) {
+        return;
+    }
+
+    if (cache->file != NULL) {
+        cache_file_store(cache->file, name, qtype, qclass, packet, len, ttl);
+    }
+
+    // Memory cache is disabled
+    if (cache->capacity == 0) {
+        return;
+    }
+
+    cache_entry_t* entry = malloc(sizeof(cache_entry_t));
+    if (entry == NULL) {
+        return;
+    }
+
+    entry->packet = malloc(len);
+    if (entry->packet == NULL) {
+        free(entry);
+        return;
+    }
+
+    normalize_cache_key(entry->name, name);
+    entry->qtype = qtype;
+    entry->qclass = qclass;
+    entry->hash = hash_cache_key(entry->name, qtype, qclass);
+    entry->len = len;
+    entry->stored = now_sec();
+    entry->expires = entry->stored + ttl;
+    memcpy(entry->packet, packet, len);
+
+    pthread_mutex_lock(&cache->lock);
+
+    // Replace an older response
+    cache_entry_t* old = find_entry(cache, entry->name, qtype, qclass, entry->hash);
+    if (old != NULL) {
+        remove_entry(cache, old);
+    }
+
+    // Evict the least recently used entry
+    if (cache->count >= cache->capacity) {
+        remove_entry(cache, cache->lru_tail);
+    }
+
+    cache_entry_t** bucket = &cache->buckets[entry->hash & (cache->nbuckets - 1)];
+    entry->next = *bucket;
+    *bucket = entry;
+
+    lru_push(cache, entry);
+    cache->count++;
+
+    pthread_mutex_unlock(&cache->lock);
+}
+
+/**
+ * @brief Free all entries of the cache.
+ *
+ * @param cache Pointer to the cache.
+ */
+void cache_free(cache_t* cache) {
+    while (cache->lru_head != NULL) {
+        remove_entry(cache, cache->lru_head);
+    }
+
+    free(cache->buckets);
+    cache->buckets = NULL;
+
+    pthread_mutex_destroy(&cache->lock);
+}
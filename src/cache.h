@@ -0,0 +1,59 @@
+/**
+ * @file cache.h
+ * @brief Response Cache Header
+ *
+ * This C header file, "cache.h" defines the structures and functions of an in-memory cache of
+ * DNS responses. Responses are stored as raw packets keyed by (QNAME, QTYPE, QCLASS) and expire
+ * according to the minimum TTL of their records. Negative responses (NXDOMAIN and NODATA) are
+ * cached according to the SOA record of the authority section (RFC 2308).
+ *
+ * The cache is protected by a mutex, so it can be shared by multiple resolvers (threads).
+ *
+ * @author Oleksandr Turytsia (xturyt00)
+ * @date October 18, 2023
+ */
+#ifndef CACHE_H
+#define CACHE_H
+
+#include "dns.h"
+#include "cachefile.h"
+#include "parse.h"
+
+#define CACHE_SIZE 65536
+
+// Cached response
+typedef struct cache_entry {
+    char name[MAX_NAME];            // Queried name (lowercase, without the trailing dot)
+    unsigned short qtype;           // Type of the query
+    unsigned short qclass;          // Class of the query
+    unsigned int hash;              // Hash of the key
+    unsigned char* packet;          // Response packet
+    int len;                        // Length of the response packet
+    long long stored;               // Time when the response was stored (s, CLOCK_MONOTONIC)
+    long long expires;              // Time when the response expires (s, CLOCK_MONOTONIC)
+    struct cache_entry* next;       // Next entry in the bucket
+    struct cache_entry* lru_prev;   // More recently used entry
+    struct cache_entry* lru_next;   // Less recently used entry
+} cache_entry_t;
+
+typedef struct cache {
+    cache_entry_t** buckets;        // Hash table
+    int nbuckets;                   // Number of buckets (power of two)
+    int count;                      // Number of entries
+    int capacity;                   // Maximum number of entries
+    cache_entry_t* lru_head;        // Most recently used entry
+    cache_entry_t* lru_tail;        // Least recently used entry
+    pthread_mutex_t lock;           // Lock of the cache
+    cache_file_t* file;             // Persistent cache file (NULL if not used)
+} cache_t;
+
+int cache_init(cache_t* cache, int capacity);
+int cache_lookup(cache_t* cache, const char* name, unsigned short qtype, unsigned short qclass, unsigned char* packet);
+void cache_store(cache_t* cache, const char* name, unsigned short qtype, unsigned short qclass, unsigned char* packet, int len);
+int get_response_ttl(unsigned char* packet, int len);
+void age_response(unsigned char* packet, int len, long long age);
+void normalize_cache_key(char* dest, const char* name);
+unsigned int hash_cache_key(const char* name, unsigned short qtype, unsigned short qclass);
+void cache_free(cache_t* cache);
+
+#endif
@@ -0,0 +1,263 @@
+/**
+ * @file cachefile.c
+ * @brief Persistent Cache File Implementation
+ *
+ * This C source file, "cachefile.c" contains the implementation of the persistent response
+ * cache. A key is hashed to a slot and up to CACHE_FILE_PROBES following slots are probed
+ * (linear probing). When all probed slots are used, the slot that expires first is replaced.
+ *
+ * Concurrent processes are synchronized by `flock`: lookups hold a shared lock and stores an
+ * exclusive lock, so a reader never sees a partially written slot. Threads of a process share the
+ * open file description, which `flock` does not exclude, so they are serialized by a mutex.
+ *
+ * The file is shared and may be corrupted, so slots are validated before they are used.
+ *
+ * @author Oleksandr Turytsia (xturyt00)
+ * @date October 18, 2023
+ */
+#include "cachefile.h"
+#include "cache.h"
+
+/**
+ * @brief Get the origin of responses of this invocation.
+ *
+ * The origin is a 64-bit FNV-1a hash of the servers (as specified by `-s`, in order), the port
+ * and the Recursion Desired flag of queries.
+ *
+ * @param args Pointer to the program's command-line arguments.
+ * @return Origin of responses.
+ */
+uint64_t cache_file_origin(args_t* args) {
+    uint64_t hash = 14695981039346656037ULL;
+    char rd = args->recursive || strlen(args->listen_addr) != 0;
+
+    for (int i = 0; i <= args->nservers; i++) {
+        // Port follows the servers, fields are separated by the terminating zero
+        const char* field = i < args->nservers ? args->source_addr[i] : args->port;
+
+        for (size_t j = 0; j <= strlen(field); j++) {
+            hash = (hash ^ (unsigned char)field[j]) * 1099511628211ULL;
+        }
+    }
+
+    return (hash ^ (unsigned char)rd) * 1099511628211ULL;
+}
+
+/**
+ * @brief Open (or create) a cache file and map it into memory.
+ *
+ * Only a new (empty) file is initialized to an empty table. An existing file with a different
+ * size or header is not a cache file of this version and it is left untouched.
+ *
+ * @param file Pointer to the cache file.
+ * @param path Path to the cache file.
+ * @param origin Origin of responses of this invocation (see `cache_file_origin`).
+ * @return 0 on success, -1 on failure (errno is set, EINVAL if the file is not a cache file).
+ */
+int cache_file_open(cache_file_t* file, const char* path, uint64_t origin) {
+    memset(file, 0, sizeof(cache_file_t));
+    file->origin = origin;
+
+    file->size = sizeof(cache_file_header_t) + (size_t)CACHE_FILE_SLOTS * sizeof(cache_file_slot_t);
+    file->fd = open(path, O_RDWR | O_CREAT, 0644);
+    if (file->fd == -1) {
+        return -1;
+    }
+
+    flock(file->fd, LOCK_EX);
+
+    struct stat st;
+    if (fstat(file->fd, &st) == -1) {
+        flock(file->fd, LOCK_UN);
+        close(file->fd);
+        return -1;
+    }
+
+    // Any other file is never truncated, a mistyped path must not destroy user data
+    int created = st.st_size == 0;
+    if ((!created && st.st_size != (off_t)file->size) || (created && ftruncate(file->fd, file->size) == -1)) {
+        if (!created) {
+            errno = EINVAL;
+        }
+        flock(file->fd, LOCK_UN);
+        close(file->fd);
+        return -1;
+    }
+
+    void* map = mmap(NULL, file->size, PROT_READ | PROT_WRITE, MAP_SHARED, file->fd, 0);
+    if (map == MAP_FAILED) {
+        flock(file->fd, LOCK_UN);
+        close(file->fd);
+        return -1;
+    }
+
+    file->header = map;
+    file->slots = (cache_file_slot_t*)((unsigned char*)map + sizeof(cache_file_header_t));
+
+    // Initialize a new file (the extended file is zeroed)
+    if (created) {
+        file->header->magic = CACHE_FILE_MAGIC;
+        file->header->version = CACHE_FILE_VERSION;
+        file->header->nslots = CACHE_FILE_SLOTS;
+        file->header->slot_size = sizeof(cache_file_slot_t);
+    }
+    else if (file->header->magic != CACHE_FILE_MAGIC || file->header->version != CACHE_FILE_VERSION ||
+             file->header->nslots != CACHE_FILE_SLOTS || file->header->slot_size != sizeof(cache_file_slot_t)) {
+        munmap(map, file->size);
+        flock(file->fd, LOCK_UN);
+        close(file->fd);
+        errno = EINVAL;
+        return -1;
+    }
+
+    flock(file->fd, LOCK_UN);
+    pthread_mutex_init(&file->lock, NULL);
+
+    return 0;
+}
+
+/**
+ * @brief Check whether a used slot is well-formed.
+ *
+ * @param slot Slot of the file.
+ * @return 1 if the name is terminated and the response fits the slot, 0 otherwise.
+ */
+static int is_slot_valid(cache_file_slot_t* slot) {
+    return slot->len <= CACHE_FILE_PACKET && memchr(slot->name, 0, MAX_NAME) != NULL;
+}
+
+/**
+ * @brief Find the slot of a key (the file must be locked).
+ *
+ * Corrupted slots and slots of other origins are skipped.
+ *
+ * @return Slot with the key, or NULL if the key is not stored.
+ */
+static cache_file_slot_t* find_slot(cache_file_t* file, const char* name, unsigned short qtype, unsigned short qclass, unsigned int hash) {
+    for (int i = 0; i < CACHE_FILE_PROBES; i++) {
+        cache_file_slot_t* slot = &file->slots[(hash + i) % CACHE_FILE_SLOTS];
+
+        if (slot->expires != 0 && slot->origin == file->origin && slot->hash == hash && slot->qtype == qtype && slot->qclass == qclass && is_slot_valid(slot) &&
+            strcmp(slot->name, name) == 0) {
+            return slot;
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief Look up a response in the cache file.
+ *
+ * The response is copied into the packet buffer and TTL values of its records are decreased by
+ * the age of the entry.
+ *
+ * @param file Pointer to the cache file.
+ * @param name Queried name.
+ * @param qtype Type of the query.
+ * @param qclass Class of the query.
+ * @param packet Buffer of size MAX_BUFF for the response.
+ * @return Length of the response, or -1 if there is no valid entry.
+ */
+int cache_file_lookup(cache_file_t* file, const char* name, unsigned short qtype, unsigned short qclass, unsigned char* packet) {
+    char key[MAX_NAME];
+    normalize_cache_key(key, name);
+    unsigned int hash = hash_cache_key(key, qtype, qclass) ^ (unsigned int)(file->origin ^ file->origin >> 32);
+
+    pthread_mutex_lock(&file->lock);
+    flock(file->fd, LOCK_SH);
+
+    cache_file_slot_t* slot = find_slot(file, key, qtype, qclass, hash);
+    long long now = time(NULL);
+    int len = -1;
+
+    if (slot != NULL && slot->expires > now) {
+        len = slot->len;
+        memcpy(packet, slot->packet, len);
+        age_response(packet, len, now - slot->stored);
+    }
+
+    flock(file->fd, LOCK_UN);
+    pthread_mutex_unlock(&file->lock);
+
+    return len;
+}
+
+/**
+ * @brief Store a response in the cache file.
+ *
+ * Responses larger than CACHE_FILE_PACKET are not stored.
+ *
+ * @param file Pointer to the cache file.
+ * @param name Queried name.
+ * @param qtype Type of the query.
+ * @param qclass Class of the query.
+ * @param packet Response packet.
+ * @param len Length of the response.
+ * @param ttl Time for which the response may be cached (s).
+ */
+void cache_file_store(cache_file_t* file, const char* name, unsigned short qtype, unsigned short qclass, unsigned char* packet, int len, int ttl) {
+    if (len > CACHE_FILE_PACKET) {
+        return;
+    }
+
+    char key[MAX_NAME];
+    normalize_cache_key(key, name);
+    unsigned int hash = hash_cache_key(key, qtype, qclass) ^ (unsigned int)(file->origin ^ file->origin >> 32);
+
+    pthread_mutex_lock(&file->lock);
+    flock(file->fd, LOCK_EX);
+
+    long long now = time(NULL);
+    cache_file_slot_t* slot = find_slot(file, key, qtype, qclass, hash);
+
+    // Use a free (or expired) slot, otherwise replace the slot that expires first
+    for (int i = 0; slot == NULL && i < CACHE_FILE_PROBES; i++) {
+        cache_file_slot_t* probe = &file->slots[(hash + i) % CACHE_FILE_SLOTS];
+
+        if (probe->expires <= now) {
+            slot = probe;
+        }
+    }
+
+    if (slot == NULL) {
+        slot = &file->slots[hash % CACHE_FILE_SLOTS];
+
+        for (int i = 1; i < CACHE_FILE_PROBES; i++) {
+            cache_file_slot_t* probe = &file->slots[(hash + i) % CACHE_FILE_SLOTS];
+
+            if (probe->expires < slot->expires) {
+                slot = probe;
+            }
+        }
+    }
+
+    slot->stored = now;
+    slot->expires = now + ttl;
+    slot->origin = file->origin;
+    slot->hash = hash;
+    slot->qtype = qtype;
+    slot->qclass = qclass;
+    slot->len = len;
+    strcpy(slot->name, key);
+    memcpy(slot->packet, packet, len);
+
+    flock(file->fd, LOCK_UN);
+    pthread_mutex_unlock(&file->lock);
+}
+
+/**
+ * @brief Unmap and close the cache file.
+ *
+ * @param file Pointer to the cache file.
+ */
+void cache_file_close(cache_file_t* file) {
+    if (file->header != NULL) {
+        munmap(file->header, file->size);
+    }
+
+    pthread_mutex_destroy(&file->lock);
+
+    close(file->fd);
+    memset(file, 0, sizeof(cache_file_t));
+}
@@ -0,0 +1,62 @@
+/**
+ * @file cachefile.h
+ * @brief Persistent Cache File Header
+ *
+ * This C header file, "cachefile.h" defines the on-disk layout and functions of the persistent
+ * response cache. The cache file is a fixed-layout hash table of raw response packets with
+ * absolute expiry times, that is mapped into memory, so it can be shared by any number of
+ * program invocations (processes). Every response is tagged by its origin (servers, port and the
+ * Recursion Desired flag), so invocations with different servers do not share answers.
+ *
+ * @author Oleksandr Turytsia (xturyt00)
+ * @date October 18, 2023
+ */
+#ifndef CACHEFILE_H
+#define CACHEFILE_H
+
+#include "dns.h"
+
+#define CACHE_FILE_MAGIC 0x434e5344     // "DSNC"
+#define CACHE_FILE_VERSION 2
+#define CACHE_FILE_SLOTS 8192
+#define CACHE_FILE_PROBES 8
+#define CACHE_FILE_PACKET 1232
+
+// Header of the cache file
+typedef struct {
+    uint32_t magic;                 // CACHE_FILE_MAGIC
+    uint32_t version;               // CACHE_FILE_VERSION
+    uint32_t nslots;                // Number of slots
+    uint32_t slot_size;             // Size of a slot in bytes
+} cache_file_header_t;
+
+// Slot of the cache file
+typedef struct {
+    int64_t stored;                 // Time when the response was stored (s, UNIX time)
+    int64_t expires;                // Time when the response expires (s, UNIX time, 0 if the slot is empty)
+    uint64_t origin;                // Origin of the response (see `cache_file_origin`)
+    uint32_t hash;                  // Hash of the key
+    uint16_t qtype;                 // Type of the query
+    uint16_t qclass;                // Class of the query
+    uint16_t len;                   // Length of the response packet
+    char name[MAX_NAME];            // Queried name (lowercase, without the trailing dot)
+    unsigned char packet[CACHE_FILE_PACKET];
+} cache_file_slot_t;
+
+// Mapped cache file
+typedef struct {
+    int fd;                         // Descriptor of the file (used for locking)
+    pthread_mutex_t lock;           // Lock of threads sharing the descriptor (flock does not exclude them)
+    size_t size;                    // Size of the mapping
+    uint64_t origin;                // Origin of responses looked up and stored by this process
+    cache_file_header_t* header;    // Mapped header
+    cache_file_slot_t* slots;       // Mapped slots
+} cache_file_t;
+
+uint64_t cache_file_origin(args_t* args);
+int cache_file_open(cache_file_t* file, const char* path, uint64_t origin);
+int cache_file_lookup(cache_file_t* file, const char* name, unsigned short qtype, unsigned short qclass, unsigned char* packet);
+void cache_file_store(cache_file_t* file, const char* name, unsigned short qtype, unsigned short qclass, unsigned char* packet, int len, int ttl);
+void cache_file_close(cache_file_t* file);
+
+#endif
@@ -0,0 +1,445 @@
+/**
+ * @file capture.c
+ * @brief Packet Capture Implementation
+ *
+ * This C source file, "capture.c" contains writing and reading of pcap captures. Every recorded
+ * DNS message is prefixed by a record header and synthesized IP and UDP headers (with valid
+ * checksums) and written through a buffered writer. Reading walks records of a mapped file and
+ * strips link, IP and transport headers without copying the messages.
+ *
+ * @author Oleksandr Turytsia (xturyt00)
+ * @date October 18, 2023
+ */
+#include "capture.h"
+
+/**
+ * @brief Read a big-endian 16-bit number.
+ *
+ * @param data Pointer to the number.
+ * @return Number in host byte order.
+ */
+static int read_u16(const unsigned char* data) {
+    return (data[0] << 8) | data[1];
+}
+
+/**
+ * @brief Read a 32-bit number of a pcap header.
+ *
+ * @param reader Pointer to the reader.
+ * @param data Pointer to the number.
+ * @return Number in host byte order.
+ */
+static unsigned int read_u32(capture_reader_t* reader, const unsigned char* data) {
+    unsigned int value;
+    memcpy(&value, data, sizeof(value));
+
+    return reader->swapped ? __builtin_bswap32(value) : value;
+}
+
+/**
+ * @brief Add data to an Internet checksum (RFC 1071).
+ *
+ * @param sum Partial sum.
+ * @param data Data to be added.
+ * @param len Length of the data (only the last chunk may have an odd length).
+ * @return New partial sum.
+ */
+static unsigned int checksum_add(unsigned int sum, const unsigned char* data, int len) {
+    for (int i = 0; i + 1 < len; i += 2) {
+        sum += read_u16(data + i);
+    }
+
+    if (len & 1) {
+        sum += data[len - 1] << 8;
+    }
+
+    return sum;
+}
+
+/**
+ * @brief Fold a partial sum into an Internet checksum.
+ *
+ * @param sum Partial sum.
+ * @return Checksum in host byte order.
+ */
+static unsigned short checksum_fold(unsigned int sum) {
+    while (sum >> 16) {
+        sum = (sum & 0xFFFF) + (sum >> 16);
+    }
+
+    return ~sum & 0xFFFF;
+}
+
+/**
+ * @brief Get the address and the port of a socket address.
+ *
+ * @param sa Socket address.
+ * @param family Address family of the packet, an address of another family is left zeroed.
+ * @param addr Where the address will be stored (network byte order, 16 bytes).
+ * @return Port in network byte order.
+ */
+static unsigned short get_endpoint(const struct sockaddr* sa, int family, unsigned char* addr) {
+    memset(addr, 0, sizeof(struct in6_addr));
+
+    if (sa->sa_family != family) {
+        return 0;
+    }
+
+    if (family == AF_INET) {
+        const struct sockaddr_in* in = (const struct sockaddr_in*)sa;
+        memcpy(addr, &in->sin_addr, sizeof(struct in_addr));
+        return in->sin_port;
+    }
+
+    const struct sockaddr_in6* in6 = (const struct sockaddr_in6*)sa;
+    memcpy(addr, &in6->sin6_addr, sizeof(struct in6_addr));
+    return in6->sin6_port;
+}
+
+/**
+ * @brief Create a capture file and write its header.
+ *
+ * @param capture Pointer to the capture.
+ * @param path Path of the capture file (truncated if it exists).
+ * @return 0 on success, -1 on failure (errno is set).
+ */
+int capture_open(capture_t* capture, const char* path) {
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd == -1) {
+        return -1;
+    }
+
+    if (writer_init(&capture->writer, fd, WRITER_SIZE)) {
+        close(fd);
+        return -1;
+    }
+
+    pthread_mutex_init(&capture->lock, NULL);
+
+    // Global header in the host byte order, the magic number tells readers which one it is
+    unsigned int header[6] = { PCAP_MAGIC, 0, 0, 0, PCAP_SNAPLEN, LINKTYPE_RAW };
+    unsigned short version[2] = { 2, 4 };
+    memcpy(&header[1], version, sizeof(version));
+
+    writer_write(&capture->writer, header, sizeof(header));
+
+    return 0;
+}
+
+/**
+ * @brief Record a DNS message.
+ *
+ * The message is stored as an IP packet with a UDP header. Messages longer than fits into
+ * the snapshot length with the headers are truncated.
+ *
+ * @param capture Pointer to the capture.
+ * @param src Address of the sender.
+ * @param dst Address of the receiver.
+ * @param payload DNS message.
+ * @param len Length of the message.
+ */
+void capture_packet(capture_t* capture, const struct sockaddr* src, const struct sockaddr* dst, const unsigned char* payload, int len) {
+    int family = src->sa_family == AF_INET6 || dst->sa_family == AF_INET6 ? AF_INET6 : AF_INET;
+    int ip_size = family == AF_INET ? 20 : 40;
+
+    if (len > PCAP_SNAPLEN - 48) {
+        len = PCAP_SNAPLEN - 48;
+    }
+
+    unsigned char src_addr[sizeof(struct in6_addr)];
+    unsigned char dst_addr[sizeof(struct in6_addr)];
+    unsigned short src_port = get_endpoint(src, family, src_addr);
+    unsigned short dst_port = get_endpoint(dst, family, dst_addr);
+    int addr_size = family == AF_INET ? 4 : 16;
+    int udp_len = len + 8;
+
+    unsigned char headers[48];
+    unsigned char* ip = headers;
+    unsigned char* udp = headers + ip_size;
+    memset(headers, 0, sizeof(headers));
+
+    if (family == AF_INET) {
+        ip[0] = 0x45;
+        ip[2] = (ip_size + udp_len) >> 8;
+        ip[3] = ip_size + udp_len;
+        ip[6] = 0x40;                       // Don't fragment
+        ip[8] = 64;                         // TTL
+        ip[9] = IPPROTO_UDP;
+        memcpy(ip + 12, src_addr, 4);
+        memcpy(ip + 16, dst_addr, 4);
+
+        unsigned short sum = checksum_fold(checksum_add(0, ip, ip_size));
+        ip[10] = sum >> 8;
+        ip[11] = sum;
+    }
+    else {
+        ip[0] = 0x60;
+        ip[4] = udp_len >> 8;
+        ip[5] = udp_len;
+        ip[6] = IPPROTO_UDP;
+        ip[7] = 64;                         // Hop limit
+        memcpy(ip + 8, src_addr, 16);
+        memcpy(ip + 24, dst_addr, 16);
+    }
+
+    memcpy(udp, &src_port, 2);
+    memcpy(udp + 2, &dst_port, 2);
+    udp[4] = udp_len >> 8;
+    udp[5] = udp_len;
+
+    // UDP checksum covers a pseudo header with addresses, protocol and length
+    unsigned int sum = checksum_add(0, src_addr, addr_size);
+    sum = checksum_add(sum, dst_addr, addr_size);
+    sum += IPPROTO_UDP + udp_len;
+    sum = checksum_add(sum, udp, 8);
+    sum = checksum_add(sum, payload, len);
+
+    unsigned short udp_sum = checksum_fold(sum);
+    if (udp_sum == 0) {
+        udp_sum = 0xFFFF;
+    }
+    udp[6] = udp_sum >> 8;
+    udp[7] = udp_sum;
+
+    struct timeval now;
+    gettimeofday(&now, NULL);
+
+    unsigned int record[4] = { now.tv_sec, now.tv_usec, ip_size + udp_len, ip_size + udp_len };
+
+    pthread_mutex_lock(&capture->lock);
+    writer_write(&capture->writer, record, sizeof(record));
+    writer_write(&capture->writer, headers, ip_size + 8);
+    writer_write(&capture->writer, payload, len);
+    pthread_mutex_unlock(&capture->lock);
+}
+
+/**
+ * @brief Write buffered packets and close the capture file.
+ *
+ * @param capture Pointer to the capture (NULL if not used).
+ */
+void capture_close(capture_t* capture) {
+    if (capture == NULL) {
+        return;
+    }
+
+    int fd = capture->writer.fd;
+
+    writer_free(&capture->writer);
+    close(fd);
+    pthread_mutex_destroy(&capture->lock);
+}
+
+/**
+ * @brief Open a capture file for reading.
+ *
+ * @param reader Pointer to the reader.
+ * @param path Path of the capture file.
+ * @return 0 on success, -1 if the file could not be mapped or it is not a pcap capture.
+ */
+int capture_reader_open(capture_reader_t* reader, const char* path) {
+    memset(reader, 0, sizeof(capture_reader_t));
+
+    int fd = open(path, O_RDONLY);
+    if (fd == -1) {
+        return -1;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) == -1 || st.st_size < 24) {
+        close(fd);
+        return -1;
+    }
+
+    // Private writable mapping, so messages can be handed to functions that take mutable packets
+    reader->size = st.st_size;
+    reader->map = mmap(NULL, reader->size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if (reader->map == MAP_FAILED) {
+        reader->map = NULL;
+        return -1;
+    }
+
+    unsigned int magic = read_u32(reader, reader->map);
+    if (magic != PCAP_MAGIC && magic != PCAP_MAGIC_NS) {
+        reader->swapped = 1;
+        magic = read_u32(reader, reader->map);
+
+        if (magic != PCAP_MAGIC && magic != PCAP_MAGIC_NS) {
+            capture_reader_close(reader);
+            return -1;
+        }
+    }
+
+    reader->linktype = read_u32(reader, reader->map + 20) & 0xFFFF;
+    reader->offset = 24;
+
+    return 0;
+}
+
+/**
+ * @brief Extract a DNS message from a captured packet.
+ *
+ * @param reader Pointer to the reader.
+ * @param data Captured packet.
+ * @param caplen Captured length of the packet.
+ * @param payload Where the pointer to the message will be stored.
+ * @param len Where the length of the message will be stored.
+ * @return 1 if the packet carries a DNS message, 0 otherwise.
+ */
+static int extract_message(capture_reader_t* reader, unsigned char* data, int caplen, unsigned char** payload, int* len) {
+    int offset = 0;
+    int ethertype = -1;
+
+    switch (reader->linktype) {
+        case LINKTYPE_NULL:
+            offset = 4;
+            break;
+        case LINKTYPE_ETHERNET:
+            if (caplen < 14) {
+                return 0;
+            }
+            ethertype = read_u16(data + 12);
+            offset = 14;
+
+            // VLAN tags
+            while ((ethertype == 0x8100 || ethertype == 0x88A8) && offset + 4 <= caplen) {
+                ethertype = read_u16(data + offset + 2);
+                offset += 4;
+            }
+            break;
+        case LINKTYPE_LINUX_SLL:
+            if (caplen < 16) {
+                return 0;
+            }
+            ethertype = read_u16(data + 14);
+            offset = 16;
+            break;
+        case LINKTYPE_RAW:
+        case LINKTYPE_IPV4:
+        case LINKTYPE_IPV6:
+            break;
+        default:
+            return 0;
+    }
+
+    if ((ethertype != -1 && ethertype != 0x0800 && ethertype != 0x86DD) || offset >= caplen) {
+        return 0;
+    }
+
+    unsigned char* ip = data + offset;
+    int left = caplen - offset;
+    int protocol;
+    int header;
+
+    if ((ip[0] >> 4) == 4) {
+        header = (ip[0] & 15) * 4;
+
+        // Fragments are not reassembled
+        if (left < 20 || header < 20 || header > left || (read_u16(ip + 6) & 0x3FFF) != 0) {
+            return 0;
+        }
+
+        protocol = ip[9];
+        if (read_u16(ip + 2) < left) {
+            left = read_u16(ip + 2);
+        }
+    }
+    else if ((ip[0] >> 4) == 6) {
+        header = 40;
+
+        if (left < 40) {
+            return 0;
+        }
+
+        protocol = ip[6];
+        if (40 + read_u16(ip + 4) < left) {
+            left = 40 + read_u16(ip + 4);
+        }
+    }
+    else {
+        return 0;
+    }
+
+    unsigned char* transport = ip + header;
+    left -= header;
+
+    if (protocol == IPPROTO_UDP) {
+        if (left < 8) {
+            return 0;
+        }
+
+        int udp_len = read_u16(transport + 4);
+        if (udp_len < 8) {
+            return 0;
+        }
+
+        *payload = transport + 8;
+        *len = (udp_len < left ? udp_len : left) - 8;
+        return 1;
+    }
+
+    if (protocol == IPPROTO_TCP) {
+        if (left < 20 || (transport[12] >> 4) * 4 > left) {
+            return 0;
+        }
+
+        // Only segments carrying a whole message with its length prefix are used
+        unsigned char* segment = transport + (transport[12] >> 4) * 4;
+        int segment_len = left - (transport[12] >> 4) * 4;
+
+        if (segment_len < 2 || read_u16(segment) != segment_len - 2) {
+            return 0;
+        }
+
+        *payload = segment + 2;
+        *len = segment_len - 2;
+        return 1;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Get the next DNS message of a capture.
+ *
+ * Packets that do not carry a DNS message are skipped. The message points into the mapped file
+ * and stays valid until the reader is closed.
+ *
+ * @param reader Pointer to the reader.
+ * @param payload Where the pointer to the message will be stored.
+ * @param len Where the length of the message will be stored.
+ * @return 1 if a message was found, 0 at the end of the capture (or at a truncated record).
+ */
+int capture_next(capture_reader_t* reader, unsigned char** payload, int* len) {
+    while (reader->offset + 16 <= reader->size) {
+        unsigned char* record = reader->map + reader->offset;
+        unsigned int caplen = read_u32(reader, record + 8);
+
+        if (caplen > reader->size - reader->offset - 16) {
+            return 0;
+        }
+
+        reader->offset += 16 + caplen;
+
+        if (extract_message(reader, record + 16, caplen, payload, len)) {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Unmap a capture file.
+ *
+ * @param reader Pointer to the reader.
+ */
+void capture_reader_close(capture_reader_t* reader) {
+    if (reader->map != NULL) {
+        munmap(reader->map, reader->size);
+    }
+
+    memset(reader, 0, sizeof(capture_reader_t));
+}
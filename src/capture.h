@@ -0,0 +1,55 @@
+/**
+ * @file capture.h
+ * @brief Packet Capture Header
+ *
+ * This C header file, "capture.h" defines writing and reading of packet captures in the classic
+ * pcap format. DNS messages sent and received by the resolver are recorded as raw IP packets
+ * (LINKTYPE_RAW) with synthesized IPv4 or IPv6 and UDP headers, so the capture can be opened by
+ * the usual tools. Messages exchanged over TCP are recorded as UDP datagrams as well.
+ *
+ * Captures are read by mapping the whole file into memory. Ethernet, Linux cooked, BSD loopback
+ * and raw IP link types are supported, DNS messages are extracted from UDP datagrams and from TCP
+ * segments carrying a whole length-prefixed message. Fragmented packets are skipped.
+ *
+ * @author Oleksandr Turytsia (xturyt00)
+ * @date October 18, 2023
+ */
+#ifndef CAPTURE_H
+#define CAPTURE_H
+
+#include "writer.h"
+
+#define PCAP_MAGIC 0xA1B2C3D4
+#define PCAP_MAGIC_NS 0xA1B23C4D
+#define PCAP_SNAPLEN 65535
+
+#define LINKTYPE_NULL 0
+#define LINKTYPE_ETHERNET 1
+#define LINKTYPE_RAW 101
+#define LINKTYPE_LINUX_SLL 113
+#define LINKTYPE_IPV4 228
+#define LINKTYPE_IPV6 229
+
+// Capture being written
+typedef struct capture {
+    writer_t writer;                // Buffered output of the capture file
+    pthread_mutex_t lock;           // Lock of the capture (shared by worker threads)
+} capture_t;
+
+// Capture being read
+typedef struct {
+    unsigned char* map;             // Mapped capture file
+    size_t size;                    // Size of the file
+    size_t offset;                  // Offset of the next record
+    int swapped;                    // Capture was written with the other byte order
+    int linktype;                   // Link type of packets
+} capture_reader_t;
+
+int capture_open(capture_t* capture, const char* path);
+void capture_packet(capture_t* capture, const struct sockaddr* src, const struct sockaddr* dst, const unsigned char* payload, int len);
+void capture_close(capture_t* capture);
+int capture_reader_open(capture_reader_t* reader, const char* path);
+int capture_next(capture_reader_t* reader, unsigned char** payload, int* len);
+void capture_reader_close(capture_reader_t* reader);
+
+#endif
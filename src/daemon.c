@@ -0,0 +1,918 @@
+/**
+ * @file daemon.c
+ * @brief Caching Forwarder Implementation
+ *
+ * This C source file, "daemon.c" contains the implementation of the caching forwarder (daemon mode).
+ * Queries of clients are received on a listening UDP socket and on TCP connections (messages are
+ * prefixed by their length, RFC 1035 4.2.2). Every query is answered from the response cache if
+ * possible, otherwise it is forwarded to the upstream server by the resolver. Clients asking the
+ * same question while it is being resolved are attached to the pending question, so the upstream
+ * server receives only one query and all the clients get the same answer.
+ *
+ * Responses are sent with the identifier and the question of the client's query. Responses that
+ * do not fit into a UDP message (512 bytes, or the payload size of the client's EDNS(0) OPT record)
+ * are truncated (TC flag), so the client can retry over TCP.
+ *
+ * Open TCP connections are kept in a list ordered by their deadlines, every received query and
+ * every response moves the connection to the end. A periodic timer closes connections whose
+ * deadline passed and that have no pending questions.
+ *
+ * @author Oleksandr Turytsia (xturyt00)
+ * @date October 18, 2023
+ */
+#include "daemon.h"
+
+static volatile sig_atomic_t stop_daemon = 0;
+
+/**
+ * @brief Stop the daemon after a termination signal.
+ *
+ * @param sig Received signal.
+ */
+static void handle_signal(int sig) {
+    (void)sig;
+    stop_daemon = 1;
+}
+
+/**
+ * @brief Read the question of a client's query.
+ *
+ * Names in queries are not compressed, labels containing dots or unprintable characters are
+ * not accepted.
+ *
+ * @param packet Query packet.
+ * @param len Length of the query packet.
+ * @param name Buffer of size MAX_NAME where the name will be stored as sent (without the trailing
+ * dot, the root is stored as ".").
+ * @param qtype Where the type of the query will be stored.
+ * @param qclass Where the class of the query will be stored.
+ * @return Length of the question section, or -1 if the question is not valid.
+ */
+static int read_question(unsigned char* packet, int len, char* name, unsigned short* qtype, unsigned short* qclass) {
+    int offset = sizeof(dns_header_t);
+    int size = 0;
+
+    while (offset < len && packet[offset] != 0) {
+        int label = packet[offset];
+
+        if (label > MAX_LABEL || offset + 1 + label >= len || size + label + 1 >= MAX_NAME - 1) {
+            return -1;
+        }
+
+        if (size > 0) {
+            name[size++] = '.';
+        }
+
+        for (int i = 1; i <= label; i++) {
+            unsigned char c = packet[offset + i];
+            if (c == '.' || !isgraph(c)) {
+                return -1;
+            }
+            name[size++] = c;
+        }
+
+        offset += label + 1;
+    }
+
+    // Root is the only name written with its trailing dot
+    if (size == 0) {
+        name[size++] = '.';
+    }
+    name[size] = 0;
+
+    if (offset + 1 + (int)sizeof(dns_question_t) > len) {
+        return -1;
+    }
+
+    dns_question_t* question = (dns_question_t*)(packet + offset + 1);
+    *qtype = ntohs(question->qtype);
+    *qclass = ntohs(question->qclass);
+
+    return offset + 1 + sizeof(dns_question_t) - sizeof(dns_header_t);
+}
+
+/**
+ * @brief Get the maximum size of a UDP response to a client's query.
+ *
+ * @param packet Query packet.
+ * @param len Length of the query packet.
+ * @param qlen Length of the question section.
+ * @return Payload size of the EDNS(0) OPT record (at least 512), or 0 if there is no OPT record.
+ */
+static int get_client_payload(unsigned char* packet, int len, int qlen) {
+    int offset = sizeof(dns_header_t) + qlen;
+
+    // OPT record has the root owner name and it is usually the only additional record
+    if (((dns_header_t*)packet)->arcount == 0 || offset + 1 + (int)sizeof(dns_rr_t) > len || packet[offset] != 0) {
+        return 0;
+    }
+
+    dns_rr_t* opt = (dns_rr_t*)(packet + offset + 1);
+    if (ntohs(opt->type) != OPT) {
+        return 0;
+    }
+
+    return ntohs(opt->class) < MAX_UDP ? MAX_UDP : ntohs(opt->class);
+}
+
+/**
+ * @brief Remove an open TCP connection from the list of connections.
+ *
+ * @param daemon Pointer to the daemon.
+ * @param conn Connection to be removed.
+ */
+static void unlink_conn(daemon_t* daemon, daemon_conn_t* conn) {
+    if (conn->prev != NULL) {
+        conn->prev->next = conn->next;
+    }
+    else {
+        daemon->conns_head = conn->next;
+    }
+
+    if (conn->next != NULL) {
+        conn->next->prev = conn->prev;
+    }
+    else {
+        daemon->conns_tail = conn->prev;
+    }
+
+    conn->prev = conn->next = NULL;
+}
+
+/**
+ * @brief Postpone the idle deadline of an open TCP connection.
+ *
+ * @param daemon Pointer to the daemon.
+ * @param conn Connection that was active (it must be in the list of connections).
+ */
+static void touch_conn(daemon_t* daemon, daemon_conn_t* conn) {
+    conn->deadline = resolver_now() + DAEMON_IDLE;
+
+    if (conn == daemon->conns_tail) {
+        return;
+    }
+
+    unlink_conn(daemon, conn);
+
+    conn->prev = daemon->conns_tail;
+    if (daemon->conns_tail != NULL) {
+        daemon->conns_tail->next = conn;
+    }
+    else {
+        daemon->conns_head = conn;
+    }
+    daemon->conns_tail = conn;
+}
+
+/**
+ * @brief Close a TCP connection, the connection is freed once it has no pending questions.
+ *
+ * @param daemon Pointer to the daemon.
+ * @param conn Connection to be closed.
+ */
+static void close_conn(daemon_t* daemon, daemon_conn_t* conn) {
+    if (!conn->closed) {
+        resolver_unwatch(daemon->resolver, &conn->watch);
+        close(conn->watch.fd);
+        unlink_conn(daemon, conn);
+        conn->closed = 1;
+        daemon->nconns--;
+    }
+
+    if (conn->refs == 0) {
+        free(conn->in);
+        free(conn->out);
+        free(conn);
+    }
+}
+
+/**
+ * @brief Write buffered responses to a TCP connection.
+ *
+ * @param daemon Pointer to the daemon.
+ * @param conn Connection of the client.
+ * @return 0 on success, -1 if the connection failed.
+ */
+static int flush_conn(daemon_t* daemon, daemon_conn_t* conn) {
+    int written = 0;
+
+    while (written < conn->outlen) {
+        ssize_t n = send(conn->watch.fd, conn->out + written, conn->outlen - written, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                break;
+            }
+            return -1;
+        }
+        written += n;
+    }
+
+    memmove(conn->out, conn->out + written, conn->outlen - written);
+    conn->outlen -= written;
+
+    // Wait until the socket is writable only if something is left
+    int writing = conn->outlen > 0;
+    if (writing == conn->writing) {
+        return 0;
+    }
+
+    conn->writing = writing;
+    return resolver_watch(daemon->resolver, &conn->watch, writing ? EPOLLIN | EPOLLOUT : EPOLLIN);
+}
+
+/**
+ * @brief Send a response to a client.
+ *
+ * @param daemon Pointer to the daemon.
+ * @param client Client of the response.
+ * @param packet Response packet (the identifier must be already rewritten).
+ * @param len Length of the response packet.
+ */
+static void send_response(daemon_t* daemon, daemon_client_t* client, unsigned char* packet, int len) {
+    daemon_conn_t* conn = client->conn;
+
+    if (conn == NULL) {
+        // UDP response that does not fit is truncated to the header and the question
+        if (len > client->payload) {
+            dns_header_t* header = (dns_header_t*)packet;
+            header->tc = 1;
+            header->ancount = header->nscount = header->arcount = 0;
+            len = sizeof(dns_header_t) + client->qlen;
+        }
+
+        // Response is lost if the socket is full, the client retries
+        sendto(daemon->udp.fd, packet, len, 0, (struct sockaddr*)&client->addr, client->addr_len);
+        return;
+    }
+
+    if (conn->closed) {
+        return;
+    }
+
+    // Append the response with its length prefix
+    if (conn->outlen + len + 2 > conn->outcap) {
+        int cap = conn->outcap ? conn->outcap : MAX_BUFF;
+        while (cap < conn->outlen + len + 2) {
+            cap *= 2;
+        }
+
+        unsigned char* out = realloc(conn->out, cap);
+        if (out == NULL) {
+            close_conn(daemon, conn);
+            return;
+        }
+
+        conn->out = out;
+        conn->outcap = cap;
+    }
+
+    conn->out[conn->outlen++] = len >> 8;
+    conn->out[conn->outlen++] = len & 0xFF;
+    memcpy(conn->out + conn->outlen, packet, len);
+    conn->outlen += len;
+
+    touch_conn(daemon, conn);
+
+    if (flush_conn(daemon, conn)) {
+        close_conn(daemon, conn);
+    }
+}
+
+/**
+ * @brief Remove the OPT record from a response (RFC 6891 6.1.1).
+ *
+ * @param daemon Pointer to the daemon.
+ * @param packet Response packet, it is modified.
+ * @param len Length of the response packet.
+ * @return Length of the response without the OPT record.
+ */
+static int strip_opt(daemon_t* daemon, unsigned char* packet, int len) {
+    if (((dns_header_t*)packet)->arcount == 0 || parse_message(daemon->message, packet, len)) {
+        return len;
+    }
+
+    dns_message_t* message = daemon->message;
+
+    for (int i = message->nrecords - 1; i >= 0; i--) {
+        dns_record_t* record = &message->records[i];
+
+        if (record->section == SECTION_ADDITIONAL && record->type == OPT) {
+            // OPT record has the root owner name, so no other name points into it
+            int end = record->rdata + record->rdlength;
+            memmove(packet + record->name, packet + end, len - end);
+
+            dns_header_t* header = (dns_header_t*)packet;
+            header->arcount = htons(ntohs(header->arcount) - 1);
+
+            return len - (end - record->name);
+        }
+    }
+
+    return len;
+}
+
+/**
+ * @brief Answer a client using a response packet.
+ *
+ * The identifier of the response is replaced by the identifier of the client's query and
+ * the question by the client's question (it differs only in the case of letters). The OPT record
+ * of the upstream server is removed if the client's query had none.
+ *
+ * @param daemon Pointer to the daemon.
+ * @param client Client of the response.
+ * @param packet Response packet, it is modified.
+ * @param len Length of the response packet.
+ */
+static void answer_client(daemon_t* daemon, daemon_client_t* client, unsigned char* packet, int len) {
+    ((dns_header_t*)packet)->id = client->id;
+
+    if (len >= (int)sizeof(dns_header_t) + client->qlen) {
+        unsigned char* question = packet + sizeof(dns_header_t);
+        int same = 1;
+
+        for (int i = 0; i < client->qlen && same; i++) {
+            same = tolower(question[i]) == tolower(client->question[i]);
+        }
+
+        if (same) {
+            memcpy(question, client->question, client->qlen);
+        }
+    }
+
+    if (!client->edns) {
+        len = strip_opt(daemon, packet, len);
+    }
+
+    send_response(daemon, client, packet, len);
+}
+
+/**
+ * @brief Answer a client by an error without any records.
+ *
+ * @param daemon Pointer to the daemon.
+ * @param client Client of the response.
+ * @param rd Recursion Desired flag of the client's query.
+ * @param rcode Response code.
+ */
+static void answer_error(daemon_t* daemon, daemon_client_t* client, int rd, int rcode) {
+    unsigned char packet[sizeof(dns_header_t) + sizeof(client->question)];
+    memset(packet, 0, sizeof(dns_header_t));
+
+    dns_header_t* header = (dns_header_t*)packet;
+    header->id = client->id;
+    header->qr = 1;
+    header->rd = rd;
+    header->ra = 1;
+    header->rcode = rcode;
+    header->qdcount = htons(client->qlen > 0 ? 1 : 0);
+
+    memcpy(packet + sizeof(dns_header_t), client->question, client->qlen);
+
+    send_response(daemon, client, packet, sizeof(dns_header_t) + client->qlen);
+}
+
+/**
+ * @brief Release a client of a pending question.
+ *
+ * @param daemon Pointer to the daemon.
+ * @param client Client to be released.
+ */
+static void free_client(daemon_t* daemon, daemon_client_t* client) {
+    if (client->conn != NULL) {
+        client->conn->refs--;
+        if (client->conn->closed) {
+            close_conn(daemon, client->conn);
+        }
+    }
+
+    // Released clients are reused by subsequent queries
+    client->next = daemon->free_clients;
+    daemon->free_clients = client;
+}
+
+/**
+ * @brief Get a client for a received query (reused if possible).
+ *
+ * @param daemon Pointer to the daemon.
+ * @return Client without a question, or NULL if memory could not be allocated.
+ */
+static daemon_client_t* alloc_client(daemon_t* daemon) {
+    daemon_client_t* client = daemon->free_clients;
+
+    if (client != NULL) {
+        daemon->free_clients = client->next;
+    }
+    else if ((client = malloc(sizeof(daemon_client_t))) == NULL) {
+        return NULL;
+    }
+
+    client->qlen = 0;
+    client->payload = MAX_UDP;
+    client->edns = 0;
+    client->conn = NULL;
+    client->next = NULL;
+
+    return client;
+}
+
+/**
+ * @brief Release a pending question, so it is reused by a subsequent miss.
+ *
+ * @param daemon Pointer to the daemon.
+ * @param pending Pending question to be released.
+ */
+static void free_pending(daemon_t* daemon, daemon_pending_t* pending) {
+    pending->next = daemon->free_pending;
+    daemon->free_pending = pending;
+}
+
+/**
+ * @brief Answer all clients waiting for a pending question.
+ *
+ * Callback of the resolver used for forwarded questions. Upstream failures are reported
+ * to clients as SERVFAIL.
+ *
+ * @param resolver Pointer to the resolver.
+ * @param result Result of the upstream query.
+ * @param data Pointer to the pending question.
+ */
+static void forward_response(resolver_t* resolver, resolver_result_t* result, void* data) {
+    (void)resolver;
+
+    daemon_pending_t* pending = data;
+    daemon_t* daemon = pending->daemon;
+
+    daemon->npending--;
+
+    // Remove the question from the table, so new clients start a new query
+    daemon_pending_t** link = &daemon->pending[pending->hash & (DAEMON_BUCKETS - 1)];
+    while (*link != pending) {
+        link = &(*link)->next;
+    }
+    *link = pending->next;
+
+    daemon_client_t* client = pending->clients;
+    while (client != NULL) {
+        daemon_client_t* next = client->next;
+
+        if (result->err) {
+            answer_error(daemon, client, resolver->config.recursive, 2);
+        }
+        else {
+            // Every client gets its own copy, because the identifier and the question are rewritten
+            memcpy(daemon->buffer, result->packet, result->len);
+            answer_client(daemon, client, daemon->buffer, result->len);
+        }
+
+        free_client(daemon, client);
+        daemon->nwaiting--;
+        client = next;
+    }
+
+    free_pending(daemon, pending);
+}
+
+/**
+ * @brief Handle a query of a client.
+ *
+ * @param daemon Pointer to the daemon.
+ * @param packet Query packet.
+ * @param len Length of the query packet.
+ * @param addr Address of the client (UDP).
+ * @param addr_len Length of the address of the client.
+ * @param conn Connection of the client (NULL for UDP).
+ */
+static void handle_query(daemon_t* daemon, unsigned char* packet, int len, struct sockaddr_storage* addr, socklen_t addr_len, daemon_conn_t* conn) {
+    if (len < (int)sizeof(dns_header_t)) {
+        return;
+    }
+
+    dns_header_t* header = (dns_header_t*)packet;
+
+    // Responses are never answered
+    if (header->qr) {
+        return;
+    }
+
+    daemon_client_t* client = alloc_client(daemon);
+    if (client == NULL) {
+        return;
+    }
+
+    client->id = header->id;
+    client->conn = conn;
+    if (conn != NULL) {
+        conn->refs++;
+    }
+    else {
+        memcpy(&client->addr, addr, addr_len);
+        client->addr_len = addr_len;
+    }
+
+    int rd = header->rd;
+    char name[MAX_NAME];
+    unsigned short qtype, qclass;
+
+    int qlen = ntohs(header->qdcount) == 1 ? read_question(packet, len, name, &qtype, &qclass) : -1;
+    if (qlen == -1) {
+        answer_error(daemon, client, rd, 1);
+        free_client(daemon, client);
+        return;
+    }
+
+    memcpy(client->question, packet + sizeof(dns_header_t), qlen);
+    client->qlen = qlen;
+
+    int payload = get_client_payload(packet, len, qlen);
+    client->payload = payload ? payload : MAX_UDP;
+    client->edns = payload != 0;
+
+    // Only standard queries of the Internet class are forwarded
+    if (header->opcode != 0 || qclass != IN) {
+        answer_error(daemon, client, rd, 4);
+        free_client(daemon, client);
+        return;
+    }
+
+    // Answer from the cache
+    if (daemon->cache != NULL) {
+        int cached = cache_lookup(daemon->cache, name, qtype, IN, daemon->buffer);
+        if (cached >= 0) {
+            answer_client(daemon, client, daemon->buffer, cached);
+            free_client(daemon, client);
+            return;
+        }
+    }
+
+    // Questions differing only in the case of letters are the same pending question, the forwarded
+    // query is sent in lowercase by the resolver
+    char key[MAX_NAME];
+    normalize_cache_key(key, name);
+
+    // Clients above the limit are not queued, so the memory use is bounded
+    if (daemon->nwaiting >= DAEMON_CLIENTS) {
+        answer_error(daemon, client, rd, 2);
+        free_client(daemon, client);
+        return;
+    }
+
+    // Attach the client to the same pending question
+    unsigned int hash = hash_cache_key(key, qtype, IN);
+    daemon_pending_t** bucket = &daemon->pending[hash & (DAEMON_BUCKETS - 1)];
+
+    for (daemon_pending_t* pending = *bucket; pending != NULL; pending = pending->next) {
+        if (pending->hash == hash && pending->qtype == qtype && strcmp(pending->name, key) == 0) {
+            client->next = pending->clients;
+            pending->clients = client;
+            daemon->nwaiting++;
+            return;
+        }
+    }
+
+    // Forward the question to the upstream server (unless there are too many pending questions)
+    daemon_pending_t* pending = NULL;
+    if (daemon->npending < DAEMON_PENDING && (pending = daemon->free_pending) != NULL) {
+        daemon->free_pending = pending->next;
+    }
+    else if (daemon->npending < DAEMON_PENDING) {
+        pending = malloc(sizeof(daemon_pending_t));
+    }
+
+    if (pending == NULL) {
+        answer_error(daemon, client, rd, 2);
+        free_client(daemon, client);
+        return;
+    }
+
+    strcpy(pending->name, key);
+    pending->qtype = qtype;
+    pending->hash = hash;
+    pending->clients = client;
+    pending->daemon = daemon;
+    pending->next = *bucket;
+    *bucket = pending;
+
+    if (resolver_submit(daemon->resolver, name, qtype, forward_response, pending)) {
+        *bucket = pending->next;
+        answer_error(daemon, client, rd, 2);
+        free_client(daemon, client);
+        free_pending(daemon, pending);
+        return;
+    }
+
+    daemon->npending++;
+    daemon->nwaiting++;
+}
+
+/**
+ * @brief Read all available queries from the listening UDP socket.
+ *
+ * @param resolver Pointer to the resolver.
+ * @param watch Watch of the UDP socket.
+ * @param events Ready events.
+ */
+static void read_udp(resolver_t* resolver, resolver_watch_t* watch, unsigned int events) {
+    (void)resolver;
+    (void)events;
+
+    daemon_t* daemon = watch->data;
+
+    while (1) {
+        struct sockaddr_storage addr;
+        socklen_t addr_len = sizeof(addr);
+
+        ssize_t len = recvfrom(watch->fd, daemon->buffer, MAX_BUFF, 0, (struct sockaddr*)&addr, &addr_len);
+        if (len < 0) {
+            break;
+        }
+
+        handle_query(daemon, daemon->buffer, len, &addr, addr_len, NULL);
+    }
+}
+
+/**
+ * @brief Read queries from a TCP connection and write buffered responses.
+ *
+ * @param resolver Pointer to the resolver.
+ * @param watch Watch of the connection socket.
+ * @param events Ready events.
+ */
+static void read_tcp(resolver_t* resolver, resolver_watch_t* watch, unsigned int events) {
+    (void)resolver;
+
+    daemon_conn_t* conn = watch->data;
+    daemon_t* daemon = conn->daemon;
+
+    if ((events & EPOLLOUT) && flush_conn(daemon, conn)) {
+        close_conn(daemon, conn);
+        return;
+    }
+
+    if (!(events & (EPOLLIN | EPOLLHUP | EPOLLERR))) {
+        return;
+    }
+
+    while (1) {
+        // Input buffer grows up to the size of the first incomplete message
+        int need = MAX_UDP + 2;
+        if (conn->inlen >= 2 && ((conn->in[0] << 8) | conn->in[1]) + 2 > need) {
+            need = ((conn->in[0] << 8) | conn->in[1]) + 2;
+        }
+
+        if (conn->incap < need) {
+            unsigned char* in = realloc(conn->in, need);
+            if (in == NULL) {
+                close_conn(daemon, conn);
+                return;
+            }
+
+            conn->in = in;
+            conn->incap = need;
+        }
+
+        ssize_t n = recv(watch->fd, conn->in + conn->inlen, conn->incap - conn->inlen, 0);
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return;
+        }
+
+        if (n <= 0) {
+            close_conn(daemon, conn);
+            return;
+        }
+
+        conn->inlen += n;
+        touch_conn(daemon, conn);
+
+        // Handle all complete messages
+        int offset = 0;
+        while (conn->inlen - offset >= 2) {
+            int len = (conn->in[offset] << 8) | conn->in[offset + 1];
+            if (conn->inlen - offset - 2 < len) {
+                break;
+            }
+
+            // The query is copied, because the buffer of the connection may be freed while it is handled
+            memcpy(daemon->buffer, conn->in + offset + 2, len);
+            offset += len + 2;
+
+            conn->refs++;
+            handle_query(daemon, daemon->buffer, len, NULL, 0, conn);
+            conn->refs--;
+
+            if (conn->closed) {
+                close_conn(daemon, conn);
+                return;
+            }
+        }
+
+        memmove(conn->in, conn->in + offset, conn->inlen - offset);
+        conn->inlen -= offset;
+    }
+}
+
+/**
+ * @brief Accept all pending TCP connections.
+ *
+ * @param resolver Pointer to the resolver.
+ * @param watch Watch of the listening TCP socket.
+ * @param events Ready events.
+ */
+static void accept_tcp(resolver_t* resolver, resolver_watch_t* watch, unsigned int events) {
+    (void)events;
+
+    daemon_t* daemon = watch->data;
+
+    while (1) {
+        int sockt = accept4(watch->fd, NULL, NULL, SOCK_NONBLOCK);
+        if (sockt == -1) {
+            break;
+        }
+
+        if (daemon->nconns >= DAEMON_CONNS) {
+            close(sockt);
+            continue;
+        }
+
+        // Input buffer is allocated once the first query arrives
+        daemon_conn_t* conn = calloc(1, sizeof(daemon_conn_t));
+        if (conn == NULL) {
+            close(sockt);
+            continue;
+        }
+
+        conn->daemon = daemon;
+        conn->watch.fd = sockt;
+        conn->watch.handler = read_tcp;
+        conn->watch.data = conn;
+
+        if (resolver_watch(resolver, &conn->watch, EPOLLIN)) {
+            free(conn);
+            close(sockt);
+            continue;
+        }
+
+        touch_conn(daemon, conn);
+        daemon->nconns++;
+    }
+}
+
+/**
+ * @brief Close TCP connections that were idle for DAEMON_IDLE milliseconds.
+ *
+ * Connections with pending questions are not idle, their deadline is postponed.
+ *
+ * @param resolver Pointer to the resolver.
+ * @param watch Watch of the idle timer.
+ * @param events Ready events.
+ */
+static void expire_conns(resolver_t* resolver, resolver_watch_t* watch, unsigned int events) {
+    (void)resolver;
+    (void)events;
+
+    daemon_t* daemon = watch->data;
+    uint64_t expirations;
+
+    if (read(watch->fd, &expirations, sizeof(expirations)) < 0) {
+        return;
+    }
+
+    long long now = resolver_now();
+
+    while (daemon->conns_head != NULL && daemon->conns_head->deadline <= now) {
+        daemon_conn_t* conn = daemon->conns_head;
+
+        if (conn->refs > 0) {
+            touch_conn(daemon, conn);
+        }
+        else {
+            close_conn(daemon, conn);
+        }
+    }
+}
+
+/**
+ * @brief Create a non-blocking listening socket.
+ *
+ * @param addr Listening address.
+ * @param type SOCK_DGRAM or SOCK_STREAM.
+ * @return Socket, or -1 on failure.
+ */
+static int listen_socket(struct addrinfo* addr, int type) {
+    int sockt = socket(addr->ai_family, type | SOCK_NONBLOCK, 0);
+    if (sockt == -1) {
+        return -1;
+    }
+
+    // Several forwarders may share the address, the kernel balances queries between them
+    int on = 1;
+    setsockopt(sockt, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+    setsockopt(sockt, SOL_SOCKET, SO_REUSEPORT, &on, sizeof(on));
+
+    if (bind(sockt, addr->ai_addr, addr->ai_addrlen) == -1 || (type == SOCK_STREAM && listen(sockt, SOMAXCONN) == -1)) {
+        close(sockt);
+        return -1;
+    }
+
+    return sockt;
+}
+
+/**
+ * @brief Run the caching forwarder until it is terminated by SIGINT or SIGTERM.
+ *
+ * @param args Pointer to the program's command-line arguments.
+ * @param resolver Pointer to the resolver forwarding queries to the upstream server.
+ * @return 0 on success, otherwise an error code (see error.h).
+ */
+int run_daemon(args_t* args, resolver_t* resolver) {
+    struct addrinfo hints, *res;
+
+    memset(&hints, 0, sizeof(struct addrinfo));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_DGRAM;
+    hints.ai_flags = AI_PASSIVE;
+
+    if (getaddrinfo(args->listen_addr, args->listen_port, &hints, &res)) {
+        return E_LISTEN;
+    }
+
+    daemon_t* daemon = calloc(1, sizeof(daemon_t));
+    if (daemon == NULL || (daemon->buffer = malloc(MAX_BUFF)) == NULL || (daemon->message = malloc(sizeof(dns_message_t))) == NULL) {
+        if (daemon != NULL) {
+            free(daemon->buffer);
+        }
+        free(daemon);
+        freeaddrinfo(res);
+        return E_EAI;
+    }
+
+    daemon->resolver = resolver;
+    daemon->cache = resolver->config.cache;
+    daemon->udp.fd = listen_socket(res, SOCK_DGRAM);
+    daemon->udp.handler = read_udp;
+    daemon->udp.data = daemon;
+    daemon->tcp.fd = listen_socket(res, SOCK_STREAM);
+    daemon->tcp.handler = accept_tcp;
+    daemon->tcp.data = daemon;
+    daemon->idle.fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK);
+    daemon->idle.handler = expire_conns;
+    daemon->idle.data = daemon;
+
+    freeaddrinfo(res);
+
+    int err_code = 0;
+
+    // Idle connections are checked ten times per DAEMON_IDLE
+    struct itimerspec period;
+    period.it_interval.tv_sec = DAEMON_IDLE / 10 / 1000;
+    period.it_interval.tv_nsec = DAEMON_IDLE / 10 % 1000 * 1000000L;
+    period.it_value = period.it_interval;
+
+    if (daemon->udp.fd == -1 || daemon->tcp.fd == -1 ||
+        resolver_watch(resolver, &daemon->udp, EPOLLIN) || resolver_watch(resolver, &daemon->tcp, EPOLLIN)) {
+        err_code = E_LISTEN;
+    }
+    else if (daemon->idle.fd == -1 || timerfd_settime(daemon->idle.fd, 0, &period, NULL) ||
+             resolver_watch(resolver, &daemon->idle, EPOLLIN)) {
+        err_code = E_EAI;
+    }
+
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = handle_signal;
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+
+    while (!err_code && !stop_daemon) {
+        err_code = resolver_run(resolver, -1);
+    }
+
+    if (daemon->udp.fd != -1) {
+        close(daemon->udp.fd);
+    }
+
+    if (daemon->tcp.fd != -1) {
+        close(daemon->tcp.fd);
+    }
+
+    if (daemon->idle.fd != -1) {
+        close(daemon->idle.fd);
+    }
+
+    while (daemon->free_clients != NULL) {
+        daemon_client_t* next = daemon->free_clients->next;
+        free(daemon->free_clients);
+        daemon->free_clients = next;
+    }
+
+    while (daemon->free_pending != NULL) {
+        daemon_pending_t* next = daemon->free_pending->next;
+        free(daemon->free_pending);
+        daemon->free_pending = next;
+    }
+
+    free(daemon->buffer);
+    free(daemon->message);
+    free(daemon);
+
+    return err_code;
+}
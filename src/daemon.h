@@ -0,0 +1,95 @@
+/**
+ * @file daemon.h
+ * @brief Caching Forwarder Header
+ *
+ * This C header file, "daemon.h" defines the structures and functions of the caching forwarder
+ * (daemon mode). The forwarder listens for queries on UDP and TCP, answers them from the response
+ * cache and forwards misses to the upstream server specified by the `-s` option. Identical questions
+ * that are already being resolved are coalesced, so they share a single upstream query.
+ *
+ * Listening sockets and TCP connections are driven by the event loop of the resolver
+ * (see `resolver_watch`). Memory use is bounded: the numbers of pending questions, of clients
+ * waiting for them and of TCP connections are limited (queries above the limits are answered
+ * by SERVFAIL) and idle TCP connections are closed (RFC 7766 6.2.3).
+ *
+ * @author Oleksandr Turytsia (xturyt00)
+ * @date October 18, 2023
+ */
+#ifndef DAEMON_H
+#define DAEMON_H
+
+#include "dns.h"
+#include "resolver.h"
+
+#define DAEMON_WINDOW 256
+#define DAEMON_BUCKETS 4096
+#define DAEMON_CONNS 1024
+#define DAEMON_PENDING 4096
+#define DAEMON_CLIENTS 16384
+#define DAEMON_IDLE 10000
+#define MAX_UDP 512
+
+typedef struct daemon daemon_t;
+
+// TCP connection of a client
+typedef struct daemon_conn {
+    resolver_watch_t watch;         // Watch of the connection socket
+    daemon_t* daemon;               // Daemon that accepted the connection
+    unsigned char* in;              // Partially received messages (with length prefixes)
+    int inlen;                      // Number of bytes in the input buffer
+    int incap;                      // Size of the input buffer (grows up to the size of a message)
+    unsigned char* out;             // Responses that could not be written yet
+    int outlen;                     // Number of bytes in the output buffer
+    int outcap;                     // Size of the output buffer
+    int writing;                    // Waiting until the socket is writable
+    int closed;                     // Socket is closed, waiting for pending questions
+    int refs;                       // Number of pending questions of the connection
+    long long deadline;             // Time when the idle connection is closed (ms, CLOCK_MONOTONIC)
+    struct daemon_conn* prev;       // Previous open connection (earlier deadline)
+    struct daemon_conn* next;       // Next open connection (later deadline)
+} daemon_conn_t;
+
+// Client waiting for the answer of a pending question
+typedef struct daemon_client {
+    unsigned short id;              // Identifier of the client's query (network byte order)
+    unsigned char question[MAX_NAME + sizeof(dns_question_t)];  // Question as sent by the client
+    int qlen;                       // Length of the question
+    struct sockaddr_storage addr;   // Address of the client (UDP)
+    socklen_t addr_len;             // Length of the address
+    int payload;                    // Maximum size of a UDP response (EDNS payload size of the client)
+    int edns;                       // Client's query has an OPT record
+    daemon_conn_t* conn;            // Connection of the client (NULL for UDP)
+    struct daemon_client* next;     // Next client waiting for the same question
+} daemon_client_t;
+
+// Question being resolved by the upstream server
+typedef struct daemon_pending {
+    char name[MAX_NAME];            // Queried name (lowercase, without the trailing dot)
+    unsigned short qtype;           // Type of the query
+    unsigned int hash;              // Hash of the question
+    daemon_client_t* clients;       // Clients waiting for the answer
+    daemon_t* daemon;               // Daemon of the question
+    struct daemon_pending* next;    // Next pending question in the bucket
+} daemon_pending_t;
+
+struct daemon {
+    resolver_t* resolver;           // Resolver forwarding queries to the upstream server
+    cache_t* cache;                 // Response cache (NULL if disabled)
+    resolver_watch_t udp;           // Listening UDP socket
+    resolver_watch_t tcp;           // Listening TCP socket
+    daemon_pending_t* pending[DAEMON_BUCKETS];  // Pending questions by hash
+    resolver_watch_t idle;          // Timer closing idle TCP connections
+    int nconns;                     // Number of open TCP connections
+    daemon_conn_t* conns_head;      // Open TCP connections (earliest deadline first)
+    daemon_conn_t* conns_tail;
+    int npending;                   // Number of pending questions
+    int nwaiting;                   // Number of clients waiting for pending questions
+    daemon_client_t* free_clients;  // Released clients, reused by subsequent queries
+    daemon_pending_t* free_pending; // Released pending questions, reused by subsequent misses
+    unsigned char* buffer;          // Buffer for received queries and sent responses
+    dns_message_t* message;         // Record index of a response whose OPT record is removed
+};
+
+int run_daemon(args_t* args, resolver_t* resolver);
+
+#endif
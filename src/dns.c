@@ -11,6 +11,12 @@
  * @date October 18, 2023
  */
 #include "dns.h"
+#include "batch.h"
+#include "resolver.h"
+#include "daemon.h"
+#include "output.h"
+#include "trace.h"
+#include "follow.h"
 
 int main(int argc, char** argv) {
 
@@ -19,631 +25,424 @@ int main(int argc, char** argv) {
 
     // Read and validate program arguments
     args_err_t args_err_code = getopts(&args, argc, argv);
-    switch(args_err_code){
-        case E_UNKNOWN_OPT:
-            exit_error(args_err_code, "Unknown option");
-            break;
-        case E_PORT_INV:
-            exit_error(args_err_code, "Port is not valid (1-65535)");
-            break;
-        case E_PORT_MISS:
-            exit_error(args_err_code, "Port is missing for the option -p");
-            break;
-        case E_SRC_MISS:
-            exit_error(args_err_code, "Source address is missing for the options -s");
-            break;
-        case E_TGT_MISS:
-            exit_error(args_err_code, "Target address is not specified");
-            break;
-        case E_OPT_DOUBLE:
-            exit_error(args_err_code, "You have specified the same option twice");
-            break;
+    if (args_err_code) {
+        exit_error(args_err_code, get_error_message(args_err_code));
     }
 
-    struct addrinfo hints, *res;        // Hints and result list for getaddrinfo
-
-    memset(&hints, 0, sizeof(struct addrinfo));   // Reset hints
-    hints.ai_family = AF_UNSPEC;        // Allow IPV6 or IPV4
-    hints.ai_socktype = SOCK_DGRAM;     // UDP
+    // Recorded responses are printed offline
+    if (strlen(args.pcap_in) != 0) {
+        return run_replay(&args);
+    }
 
-    // Get ip address of a specified dns server
-    int err = getaddrinfo(args.source_addr, NULL, &hints, &res);
-    if (err) {
-        if (err == EAI_SYSTEM){
+    int daemon = strlen(args.listen_addr) != 0;
+    int batch = !daemon && strlen(args.file) != 0;
+    int sweep = !daemon && is_sweep(&args);
+    int trace = args.trace && !daemon && !batch && !sweep;
+    int follow = args.follow && !daemon && !sweep && !trace && !args.reverse;
+    int err_code;
+
+    // In batch and daemon mode names are usually repeated, so responses are cached in memory,
+    // the cache file is shared by all invocations
+    int memory_cache = (batch || daemon) && !args.no_cache;
+    cache_t cache;
+    cache_file_t cache_file;
+    cache_t* cache_ptr = NULL;
+
+    if (memory_cache || strlen(args.cache_file) != 0) {
+        if (cache_init(&cache, memory_cache ? CACHE_SIZE : 0)) {
             exit_error(E_EAI, strerror(errno));
         }
-        else{
-            exit_error(E_GAI, gai_strerror(err));
+
+        if (strlen(args.cache_file) != 0) {
+            if (cache_file_open(&cache_file, args.cache_file, cache_file_origin(&args))) {
+                exit_error(E_CACHE_FILE, get_error_message(E_CACHE_FILE));
+            }
+            cache.file = &cache_file;
         }
+
+        cache_ptr = &cache;
     }
 
-    // Buffer for ip address of a specified dns server
-    char dns_addr[res->ai_family == AF_INET6 ? INET6_ADDRSTRLEN : INET_ADDRSTRLEN];
+    // A cached response of a single query is printed without contacting the server
+    if (!batch && !daemon && !sweep && !trace && !follow && cache_ptr != NULL && (err_code = resolve_cached(&args, cache_ptr)) != -1) {
+        free_cache(cache_ptr);
 
-    // Save ip address of a dns server into the buffer
-    if (res->ai_family == AF_INET6) {
-        struct sockaddr_in6* ipv6 = (struct sockaddr_in6*)res->ai_addr;
-        inet_ntop(AF_INET6, &(ipv6->sin6_addr), dns_addr, INET6_ADDRSTRLEN);
-    }
-    else if (res->ai_family == AF_INET) {
-        struct sockaddr_in* ipv4 = (struct sockaddr_in*)res->ai_addr;
-        inet_ntop(AF_INET, &(ipv4->sin_addr), dns_addr, INET_ADDRSTRLEN);
-    }
-    else {
-        exit_error(E_FAMILY, "Unsupported address family");
+        if (err_code) {
+            exit_error(err_code, get_error_message(err_code));
+        }
+
+        return 0;
     }
 
-    // Dns query buffer
-    unsigned char query[MAX_BUFF] = { 0 };
-
-    // Construct DNS query and save it into the buffer
-    create_dns_query(&args, query);
-
-    const int dns_header_size = sizeof(dns_header_t);
-    const int dns_question_size = sizeof(dns_question_t);
-    const int qname_size = (strlen(((char*)query + dns_header_size)) + 1);
-    const int query_size = (dns_header_size + qname_size + dns_question_size);
-
-    // Buffer to store received data
-    unsigned char buffer[MAX_BUFF] = { 0 };
-
-    send_query_err_t send_err_code = send_dns_query(&args, res->ai_family, buffer, query, dns_addr, query_size);
-    switch(send_err_code){
-        case E_SOCK:
-            freeaddrinfo(res);
-            exit_error(send_err_code, "Socket creation failed");
-            break;
-        case E_SENDTO:
-            freeaddrinfo(res);
-            exit_error(send_err_code, "DNS query sendto failed");
-            break;
-        case E_TIMEOUT:
-            freeaddrinfo(res);
-            exit_error(send_err_code, "Receive timeout reached. No data received");
-            break;
-        case E_RECVFROM:
-            freeaddrinfo(res);
-            exit_error(send_err_code, "DNS query recvfrom failed");
-            break;
+    // Resolve dns servers only once, they are shared by all queries
+    dns_server_t servers[MAX_SERVERS];
+    for (int i = 0; i < args.nservers; i++) {
+        resolve_server(&args, args.source_addr[i], &servers[i]);
     }
 
-    // Clean up getaddrinfo
-    freeaddrinfo(res);
+    // Sent queries and received responses are recorded by all resolvers
+    capture_t capture;
+    capture_t* capture_ptr = NULL;
 
-    // Extract the DNS header
-    dns_header_t* dns_header = (dns_header_t*)buffer;
-    
-    switch(dns_header->rcode){
-        case RCODE_FORMAT_ERROR:
-            exit_error(E_FORMAT, "RCODE 1, Format error");
-            break;
-        case RCODE_SERVER_FAILURE:
-            exit_error(E_SERVER_FAIL, "RCODE 2, Server failure");
-            break;
-        case RCODE_NAME_ERROR:
-            exit_error(E_NAME, "RCODE 3, Name error");
-            break;
-        case RCODE_NOT_IMPLEMENTED:
-            exit_error(E_NOT_IMPL, "RCODE 4, Not implemented");
-            break;
-        case RCODE_REFUCED:
-            exit_error(E_REFUSED, "RCODE 5, Refused");
-            break;
+    if (strlen(args.pcap_out) != 0) {
+        if (capture_open(&capture, args.pcap_out)) {
+            exit_error(E_CAPTURE_FILE, get_error_message(E_CAPTURE_FILE));
+        }
+        capture_ptr = &capture;
     }
 
-    // Extract the DNS question
-    dns_question_t* dns_question = (dns_question_t*)(buffer + dns_header_size + qname_size);
+    // Iterative resolution, root hints are the servers unless they are read from a file
+    if (trace) {
+        int nhints = args.nservers;
 
-    unsigned short qtype = ntohs(dns_question->qtype);
-    unsigned short qclass = ntohs(dns_question->qclass);
+        if (strlen(args.root_hints) != 0 && (nhints = load_root_hints(&args, args.root_hints, servers)) <= 0) {
+            exit_error(nhints == -1 ? E_FILE : E_TRACE, get_error_message(nhints == -1 ? E_FILE : E_TRACE));
+        }
 
-    // Set pointer to QNAME
-    unsigned char* pointer = (unsigned char*)(buffer + dns_header_size);
+        err_code = run_trace(&args, servers, nhints, capture_ptr);
+        free_cache(cache_ptr);
+        capture_close(capture_ptr);
 
-    printf("Authoritative: %s, Recursive: %s, Truncated: %s\n",  bool_to_yes_no(dns_header->aa), bool_to_yes_no(dns_header->rd), bool_to_yes_no(dns_header->tc));
-    printf("Question section (%d)\n", htons(dns_header->qdcount));
+        if (err_code) {
+            exit_error(err_code, err_code == E_EAI ? strerror(errno) : get_error_message(err_code));
+        }
 
-    char qname[MAX_BUFF] = {0};
+        return 0;
+    }
 
-    parse_domain_name(pointer, buffer, qname);
+    // Address lookup of the target or of every name from the file
+    if (follow) {
+        resolver_t resolver;
+        err_code = setup_resolver(&resolver, &args, servers, cache_ptr, capture_ptr);
+        if (err_code) {
+            exit_error(err_code, err_code == E_EAI ? strerror(errno) : get_error_message(err_code));
+        }
 
-    printf(" %s, %s, %s\n", qname, get_dns_type(qtype), get_dns_class(qclass));
+        err_code = run_follow(&args, &resolver);
+        resolver_free(&resolver);
+        free_cache(cache_ptr);
+        capture_close(capture_ptr);
 
-    pointer += qname_size + dns_question_size;
+        if (err_code && !batch) {
+            exit_error(err_code, get_error_message(err_code));
+        }
 
-    printf("Answer section (%d)\n", htons(dns_header->ancount));
-    print_rr(pointer, buffer, htons(dns_header->ancount), args.test);
+        return err_code;
+    }
 
-    printf("Authority section (%d)\n", htons(dns_header->nscount));
-    print_rr(pointer, buffer, htons(dns_header->nscount), args.test);
+    // Multi-threaded batch mode, every worker has its own resolver (the cache is shared)
+    if (batch && args.jobs > 1) {
+        err_code = run_parallel_batch(&args, servers, cache_ptr, capture_ptr);
+        free_cache(cache_ptr);
+        capture_close(capture_ptr);
+        return err_code;
+    }
 
-    printf("Additional section (%d)\n", htons(dns_header->arcount));
-    print_rr(pointer, buffer, htons(dns_header->arcount), args.test);
+    resolver_t resolver;
+    err_code = setup_resolver(&resolver, &args, servers, cache_ptr, capture_ptr);
+    if (err_code) {
+        exit_error(err_code, err_code == E_EAI ? strerror(errno) : get_error_message(err_code));
+    }
 
-    return 0;
-}
+    // Daemon mode, forward queries of clients until the program is terminated
+    if (daemon) {
+        err_code = run_daemon(&args, &resolver);
+        resolver_free(&resolver);
+        free_cache(cache_ptr);
+        capture_close(capture_ptr);
 
-/**
- * @brief Print DNS Resource Records (RRs)
- *
- * This function prints DNS resource records (RRs) based on the information provided in the buffer.
- * It iterates through the RRs and prints their details, such as name, type, class, TTL, and data content.
- *
- * @param pointer Pointer to the beginning of the RRs section.
- * @param buffer Pointer to the DNS packet buffer.
- * @param n Number of RRs to print.
- */
-void print_rr(unsigned char* pointer, unsigned char* buffer, int n, int is_test) {
-    // Iterate through each Resource Record (RR) in a specific section
-    for (int i = 0; i < n; i++) {
-        // Initialize a buffer to store the parsed domain name
-        char name[MAX_NAME] = { 0 };
-
-        // Parse the domain name and update the pointer accordingly
-        parse_domain_name(pointer, buffer, name);
-        pointer += get_name_length(pointer, name);
-
-        // Access the DNS Resource Record structure at the current pointer position
-        dns_rr_t* dns_rr = (dns_rr_t*)(pointer);
-
-        // Extract and convert RR type, class, TTL, and RD length to host byte order
-        unsigned short rr_type = ntohs(dns_rr->type);
-        unsigned short rr_class = ntohs(dns_rr->class);
-        unsigned int rr_ttl = ntohl(dns_rr->ttl);
-        unsigned short rr_rdlength = ntohs(dns_rr->rdlength);
-
-        // Print RR information: name, type, class, TTL, and data
-        printf(" %s, %s, %s, %d, ", name, get_dns_type(rr_type), get_dns_class(rr_class), is_test ? 0 : rr_ttl);
-
-        // Based on the RR type, print the associated data
-        switch (rr_type) {
-            case A:
-                print_ipv4_data(pointer);
-                break;
-            case CNAME:
-            case PTR:
-                print_domain_name_data(pointer, buffer);
-                break;
-            case AAAA:
-                print_ipv6_data(pointer);
-                break;
-            case SOA:
-                print_soa_data(((unsigned char*)dns_rr + sizeof(dns_rr_t)), buffer);
-                break;
-            default:
-                printf("%s is not supported yet.\n", get_dns_type(rr_type));
+        if (err_code) {
+            exit_error(err_code, err_code == E_EAI ? strerror(errno) : get_error_message(err_code));
         }
 
-        // Move the pointer to the next RR by adding the size of RR header and RD length
-        pointer += sizeof(dns_rr_t) + rr_rdlength;
+        return 0;
     }
-}
 
-/**
- * @brief Print IPv4 data from a DNS resource record (A record)
- *
- * This function prints the IPv4 address data from a DNS A record.
- *
- * @param pointer Pointer to the beginning of the RDATA section of the A record.
- */
-void print_ipv4_data(unsigned char* pointer) {
-    struct in_addr ipv4_addr;
-    memcpy(&ipv4_addr, pointer + sizeof(dns_rr_t), sizeof(struct in_addr));
-    char ip_address[INET_ADDRSTRLEN];
-    inet_ntop(AF_INET, &ipv4_addr, ip_address, INET_ADDRSTRLEN);
-    printf("%s\n", ip_address);
-}
+    // Sweep mode, resolve every address of the range
+    if (sweep) {
+        err_code = run_sweep(&args, &resolver);
+        resolver_free(&resolver);
+        free_cache(cache_ptr);
+        capture_close(capture_ptr);
+        return err_code;
+    }
 
-/**
- * @brief Print domain name data from a DNS resource record (CNAME or PTR record)
- *
- * This function prints the domain name data from a DNS CNAME or PTR record.
- *
- * @param pointer Pointer to the beginning of the RDATA section of the CNAME or PTR record.
- * @param buffer Pointer to the DNS packet buffer.
- */
-void print_domain_name_data(unsigned char* pointer, unsigned char* buffer) {
-    char data[MAX_NAME] = { 0 };
-    parse_domain_name(pointer + sizeof(dns_rr_t), buffer, data);
-    printf("%s\n", data);
-}
+    // Batch mode, resolve every name from the file
+    if (batch) {
+        err_code = run_batch(&args, &resolver);
+        resolver_free(&resolver);
+        free_cache(cache_ptr);
+        capture_close(capture_ptr);
+        return err_code;
+    }
 
-/**
- * @brief Print IPv6 data from a DNS resource record (AAAA record)
- *
- * This function prints the IPv6 address data from a DNS AAAA record.
- *
- * @param pointer Pointer to the beginning of the RDATA section of the AAAA record.
- */
-void print_ipv6_data(unsigned char* pointer) {
-    struct in6_addr ipv6_addr;
-    memcpy(&ipv6_addr, pointer + sizeof(dns_rr_t), sizeof(struct in6_addr));
-    char ip_address[INET6_ADDRSTRLEN];
-    inet_ntop(AF_INET6, &ipv6_addr, ip_address, INET6_ADDRSTRLEN);
-    printf("%s\n", ip_address);
+    err_code = resolve_single(&args, &resolver);
+    resolver_free(&resolver);
+    free_cache(cache_ptr);
+    capture_close(capture_ptr);
+
+    if (err_code) {
+        exit_error(err_code, get_error_message(err_code));
+    }
+
+    return 0;
 }
 
 /**
- * @brief Print SOA data from a DNS resource record (SOA record)
- *
- * This function prints the Start of Authority (SOA) data from a DNS SOA record.
+ * @brief Free the response cache and close its cache file.
  *
- * @param pointer Pointer to the beginning of the RDATA section of the SOA record.
- * @param buffer Pointer to the DNS packet buffer.
+ * @param cache Pointer to the cache (NULL if the cache is disabled).
  */
-void print_soa_data(unsigned char* pointer, unsigned char* buffer) {
-    char mname[MAX_NAME] = { 0 };
-    char rname[MAX_NAME] = { 0 };
-
-    int mname_len, rname_len;
-
-    parse_domain_name(pointer, buffer, mname);
-    mname_len = get_name_length(pointer, mname);
-
-    parse_domain_name(pointer + mname_len, buffer, rname);
-    rname_len = get_name_length(pointer + mname_len, rname);
+void free_cache(struct cache* cache) {
+    if (cache == NULL) {
+        return;
+    }
 
-    dns_soa_t* soa = (dns_soa_t*)(pointer + mname_len + rname_len);
+    if (cache->file != NULL) {
+        cache_file_close(cache->file);
+    }
 
-    printf("%s, %s, %d, %d, %d, %d, %d\n", mname, rname, ntohl(soa->serial), ntohl(soa->refresh), ntohl(soa->retry), ntohl(soa->expire), ntohl(soa->min_ttl));
+    cache_free(cache);
 }
 
-
-
 /**
- * @brief Send a DNS query to a server and receive a response.
+ * @brief Print the response of the single name specified as the target address.
  *
- * This function constructs a UDP socket, sends a DNS query to a server, and waits for a response.
+ * In machine-readable formats the result is written as a single record, also if the query failed.
  *
  * @param args Pointer to the program's command-line arguments.
- * @param ai_family Address family (AF_INET for IPv4 or AF_INET6 for IPv6).
- * @param buffer Pointer to the buffer for storing the received data.
- * @param query Pointer to the DNS query.
- * @param addr IP address of the target DNS server.
- * @param qlen Length of the query.
- * @return send_query_err_t indicating the result of the query operation.
+ * @param index Index of the query (its position in the `-q` list, starting from 1).
+ * @param err Error code of the query (0 on success).
+ * @param packet Response packet.
+ * @param len Length of the response packet.
+ * @return Error code of the query (including response code errors).
  */
-send_query_err_t send_dns_query(args_t* args, int ai_family, unsigned char* buffer, unsigned char* query, char* addr, int qlen) {
-    int sockt;
-    int err;
-    socklen_t addr_len;
-    ssize_t bytes_received;
-
-    // Create a sockaddr_storage structure to store server information
-    struct sockaddr_storage server;
-
-    memset(&server, 0, sizeof(struct sockaddr_storage));
-
-    // Fill in server information based on the address family
-    if (ai_family == AF_INET) {
-        struct sockaddr_in* server4 = (struct sockaddr_in*)&server;
-        server4->sin_family = AF_INET;
-        server4->sin_port = htons(atoi(args->port));
-        inet_ntop(AF_INET, &server4->sin_addr, (char*)addr, INET_ADDRSTRLEN);
-    }
-    else {
-        struct sockaddr_in6* server6 = (struct sockaddr_in6*)&server;
-        server6->sin6_family = AF_INET6;
-        server6->sin6_port = htons(atoi(args->port));
-        inet_pton(AF_INET6, (char*)addr, &server6->sin6_addr);
-    }
-
-    // Create a UDP socket
-    sockt = socket(ai_family, SOCK_DGRAM, IPPROTO_UDP);
-    if (sockt == -1) {
-        close(sockt);
-        return E_SOCK;
+static int print_target(args_t* args, int index, int err, unsigned char* packet, int len) {
+    if (args->format == FORMAT_TEXT) {
+        return err ? err : print_response(packet, len, args->test);
     }
 
-    // Set a timeout for the socket to handle potential delays
-    struct timeval timeout;
-    timeout.tv_sec = 5;  // 5 secs
-    timeout.tv_usec = 0;
-    setsockopt(sockt, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
-
-    // Determine the size of the sockaddr structure based on the address family
-    int sockaddr_size = ai_family == AF_INET ? sizeof(struct sockaddr_in) : sizeof(struct sockaddr_in6);
-
-    // Send the DNS query to the server
-    err = sendto(sockt, query, qlen, 0, (struct sockaddr*)&server, sockaddr_size);
-    if (err < 0) {
-        perror("sendto failed");
-        close(sockt);
-        return E_SENDTO;
+    writer_t writer;
+    if (writer_init(&writer, STDOUT_FILENO, MAX_BUFF)) {
+        exit_error(E_EAI, strerror(errno));
     }
 
-    // Receive the DNS response from the server
-    addr_len = sizeof server;
-    bytes_received = recvfrom(sockt, buffer, MAX_BUFF, 0, (struct sockaddr*)&server, &addr_len);
-    if (bytes_received == -1) {
-        close(sockt);
-
-        // Check for timeout errors, handle accordingly
-        if (errno == EWOULDBLOCK || errno == EAGAIN) {
-            ;
-            return E_TIMEOUT;
-        } else {
-            return E_RECVFROM;
-        }
-    } 
+    err = write_result(&writer, args->format, index, args->target_addr, err, packet, len, args->test);
+    writer_free(&writer);
 
-    // Close the socket and return success
-    close(sockt);
-    return 0;
+    return err;
 }
 
 /**
- * @brief Parse a domain name from DNS response data.
+ * @brief Print cached responses of the single name specified as the target address.
  *
- * This function parses a domain name from DNS response data and constructs the result
- * in a human-readable format. It handles both regular domain names and domain name compression.
+ * Responses are printed only if all query types are cached.
  *
- * @param rdata Pointer to the DNS response data containing the domain name.
- * @param buffer Pointer to the DNS response buffer for handling compression pointers.
- * @param result Buffer to store the parsed domain name as a human-readable string.
+ * @param args Pointer to the program's command-line arguments.
+ * @param cache Pointer to the response cache.
+ * @return -1 if a response is not cached, otherwise 0 or the first rcode error (see error.h).
  */
-void parse_domain_name(unsigned char* rdata, unsigned char* buffer, char* result) {
-    unsigned int position = 0;
-    unsigned int len;
+int resolve_cached(args_t* args, struct cache* cache) {
+    char name[MAX_NAME] = { 0 };
+    get_query_name(args, args->target_addr, name);
 
-    while (1) {
-        len = rdata[position++];
+    unsigned short qtypes[MAX_QTYPES];
+    int nqtypes = get_query_types(args, qtypes);
 
-        // End of the domain name
-        if (len == 0) {
-            break;
-        }
+    unsigned char* buffer = malloc(nqtypes * MAX_BUFF);
+    if (buffer == NULL) {
+        exit_error(E_EAI, strerror(errno));
+    }
 
-        // Check for message compression (The first two bits are ones)
-        // 11XX XXXX & 1100 0000 == 1100 0000
-        if ((len & 192) == 192) {
-            // A pointer to another location in the packet
-            unsigned int offset = rdata[position++];
-            // Recursively parse the domain name at the offset
-            parse_domain_name(buffer + offset, buffer, result);
-            return;
-        }
-        else {
-            for (int i = 0; i < (int)len; i++) {
-                result[strlen(result)] = rdata[position++];
-            }
-            result[strlen(result)] = '.';
+    int lens[MAX_QTYPES];
+    for (int i = 0; i < nqtypes; i++) {
+        lens[i] = cache_lookup(cache, name, qtypes[i], IN, buffer + i * MAX_BUFF);
+        if (lens[i] == -1) {
+            free(buffer);
+            return -1;
         }
     }
-}
 
-/**
- * @brief Compress a domain name and store it in the destination buffer.
- *
- * This function prepares a domain name for compression and invokes the 'compress' function
- * to compress it for inclusion in a DNS response. The result is stored in the destination buffer.
- *
- * @param dest Pointer to the destination buffer for the compressed domain name.
- * @param src Pointer to the source domain name to be compressed.
- */
-void compress_domain_name(unsigned char* dest, char* src) {
-    // Append a dot to the source domain name to ensure proper compression
-    // Because the 'compress' function needs to detect a dot
-    strcat((char*)src, ".");
-    // Invoke the 'compress' function to compress the domain name recursively
-    compress(dest + 1, src, 0);
+    int err_code = 0;
+    for (int i = 0; i < nqtypes; i++) {
+        // Response is printed with the flag of this query, not of the query that was cached
+        ((dns_header_t*)(buffer + i * MAX_BUFF))->rd = args->recursive;
+
+        int err = print_target(args, i + 1, 0, buffer + i * MAX_BUFF, lens[i]);
+        err_code = err_code ? err_code : err;
+    }
+
+    free(buffer);
+
+    return err_code;
 }
 
 /**
- * @brief Compress a domain name for DNS response data.
- *
- * P.s Im very proud creator of this function.
- *
- * This function compresses a domain name for inclusion in a DNS response by replacing
- * consecutive periods with a single length byte and a pointer to the domain name's position.
- *
- * @example www.google.com => 3www6google3com
+ * @brief Get the maximum number of outstanding queries of a resolver.
  *
- * @param dest Pointer to the destination buffer where the compressed domain name is stored.
- * @param src Pointer to the source domain name to be compressed.
- * @param len Current length of the domain name part being processed.
+ * @param args Pointer to the program's command-line arguments.
+ * @return Value of `--inflight`, or the default window of the mode.
  */
-void compress(unsigned char* dest, char* src, int len) {
-    // If the current character is null, return, indicating the end of the domain name
-    if (*src == 0) {
-        return;
+int get_window(args_t* args) {
+    if (args->inflight != 0) {
+        return args->inflight;
     }
 
-    // If the current character is a dot, encode the length of the section and continue compression
-    if (*src == '.') {
-        *(dest - len - 1) = len;
-        // Continue compression after the dot and reset length for the next token
-        compress(dest + 1, src + 1, 0);
-    }
-    // If the current character is not a dot, copy it to the destination buffer and continue compression
-    else {
-        *dest = *src;
-        // Continue compression with an increased length
-        compress(dest + 1, src + 1, len + 1);
-    }
+    // Forwarder and sweeps have many queries at once, address lookups send A and AAAA at once,
+    // other modes send queries of all `-q` types of a name at once by default
+    return strlen(args->listen_addr) != 0 ? DAEMON_WINDOW : is_sweep(args) ? SWEEP_WINDOW : args->follow ? FOLLOW_WINDOW :
+           args->nqtypes > 1 ? args->nqtypes : 1;
 }
 
 /**
- * @brief Create a DNS query packet based on program arguments.
- *
- * This function constructs a DNS query packet based on the provided program arguments
- * and stores it in the 'query' buffer.
+ * @brief Initialize a resolver based on program arguments.
  *
- * @param args Pointer to the program arguments structure.
- * @param query Pointer to the buffer where the DNS query packet will be stored.
+ * @param resolver Pointer to the resolver.
+ * @param args Pointer to the program's command-line arguments.
+ * @param servers Resolved DNS servers (one per `-s` option).
+ * @param cache Pointer to the response cache (NULL if disabled).
+ * @param capture Pointer to the capture of sent and received messages (NULL if disabled).
+ * @return 0 on success, E_EAI if the resolver could not be initialized (errno is set),
+ * E_SOCK if the socket could not be created.
  */
-void create_dns_query(args_t* args, unsigned char* query) {
-    // Initialize the DNS header
-    dns_header_t dns_header = {
-        .id = htons(getpid()),      // Identificator
-        .qr = 0,                    // Query
-        .opcode = 0,                // Standard query
-        .aa = 0,                    // Authoritative 
-        .tc = 0,                    // Truncated 
-        .rd = args->recursive,      // Recursion Desired
-        .ra = 0,                    // Recursion Available
-        .z = 0,                     // Reserved
-        .cd = 0,
-        .ad = 0,
-        .rcode = 0,                 // Response code
-        .qdcount = htons(1),        // Number of questions, in network byte order
-        .ancount = 0,               // Number of answers
-        .nscount = 0,               // Number of authority records
-        .arcount = 0                // Number of additional records
+int setup_resolver(struct resolver* resolver, args_t* args, dns_server_t* servers, struct cache* cache, struct capture* capture) {
+    resolver_config_t config = {
+        .window = get_window(args),
+        // Forwarder relies on the recursion of the upstream server
+        .recursive = args->recursive || strlen(args->listen_addr) != 0,
+        .lowercase = strlen(args->listen_addr) != 0,
+        .timeout = args->timeout,
+        .retries = args->retries,
+        .tcp = args->tcp,
+        .uring = args->uring,
+        .edns = args->edns,
+        .cache = cache,
+        .capture = capture,
     };
 
-    // Copy the DNS header into the query buffer
-    memcpy(query, &dns_header, sizeof(dns_header_t));
-
-    // Set up pointers for the question section and a buffer for domain name compression
-    unsigned char* qname = (unsigned char*)(query + sizeof(dns_header_t));
-    unsigned char qbuffer[MAX_BUFF] = {0};
+    if (resolver_init(resolver, &config)) {
+        return E_EAI;
+    }
 
-    // Generate the question section based on the specified target address
-    if (args->reverse) {
-        // Determine whether the target address is IPv4 or IPv6 and generate the reverse address format accordingly
-        if (is_ipv4(args->target_addr)) {
-            reverse_dns_ipv4((char*)qbuffer, args->target_addr);
-        }
-        else {
-            reverse_dns_ipv6((char*)qbuffer, args->target_addr);
+    for (int i = 0; i < args->nservers; i++) {
+        if (resolver_add_server(resolver, &servers[i]) == -1) {
+            resolver_free(resolver);
+            return E_SOCK;
         }
     }
-    else {
-        // For non-reverse queries, simply copy the target address to the buffer
-        strcpy((char*)qbuffer, args->target_addr);
-        
-    }
-
-    // Compress the domain name in the question section
-    compress_domain_name(qname, (char*)qbuffer);
-
-    // Calculate the length of the compressed domain name
-    int len = strlen((char*)qname);
-
-    // Set up the DNS question structure in the query buffer
-    dns_question_t* qinfo = (dns_question_t*)(qname + len + 1);
-
-    // Set the query type and class based on the specified arguments
-    qinfo->qtype = htons(args->ipv6 ? AAAA : args->reverse ? PTR : A);
-    qinfo->qclass = htons(1);   // Internet class (IN) by default
 
+    return 0;
 }
 
 /**
- * @brief Create a reverse DNS domain name for an IPv4 address.
+ * @brief Store the response of a single query.
  *
- * This function generates a reverse DNS domain name for the given IPv4 address and
- * stores it in the 'dest' buffer.
+ * Callback of the resolver used when a single name is queried. A copy of the response is
+ * stored in the user data, so responses of all query types are printed in the order of `-q`.
  *
- * @param dest Pointer to the destination buffer where the reverse DNS domain name will be stored.
- * @param addr Pointer to the IPv4 address to be reversed.
+ * @param resolver Pointer to the resolver.
+ * @param result Result of the query.
+ * @param data Pointer to the result of the query.
  */
-void reverse_dns_ipv4(char* dest, char* addr) {
-    // Iterate through each octet of the IPv4 address using dots as delimiters
-    for (char* token = strtok(addr, "."); token != NULL; token = strtok(NULL, ".")) {
+static void store_single(resolver_t* resolver, resolver_result_t* result, void* data) {
+    (void)resolver;
+    single_result_t* single = data;
 
-        // Create a temporary buffer to hold the current state of the reversed DNS name
-        char buf[MAX_BUFF] = { 0 };
+    single->err = result->err;
+    single->len = result->len;
 
-        // Copy the current state of the reversed DNS name into the temporary buffer
-        strcpy(buf, (char*)dest);
-
-        // If the temporary buffer is not empty, append a dot before adding the current octet
-        if (*buf != 0) {
-            sprintf((char*)dest, "%s.%s", token, buf);
-        }
-        // If the temporary buffer is empty, add the current octet without a preceding dot (first octet only)
-        else {
-            sprintf((char*)dest, "%s.", token);
+    if (!result->err) {
+        single->packet = malloc(result->len);
+        if (single->packet == NULL) {
+            exit_error(E_EAI, strerror(errno));
         }
+        memcpy(single->packet, result->packet, result->len);
     }
-
-    // Add ipv4 prefix
-    strcat((char*)dest, IPV4_REVERSE_PREFIX);
 }
 
 /**
- * @brief Check if the given address is an IPv4 address.
+ * @brief Resolve the single name specified as the target address.
  *
- * This function checks whether the given address is an IPv4 address by
- * looking for the presence of a colon (':' character).
+ * Queries of all types of `-q` are sent at the same time, responses are printed in the order of
+ * the types once all queries are finished.
  *
- * @param addr Pointer to the address to be checked.
- * @return True if it is an IPv4 address, false otherwise.
+ * @param args Pointer to the program's command-line arguments.
+ * @param resolver Pointer to the resolver.
+ * @return 0 on success, otherwise the error code of the first failed query (see error.h).
  */
-int is_ipv4(char* addr) {
-    while (*addr != '\0') {
-        if (*addr == ':') {
-            return 0;  // Found a colon, not an IPv4 address
-        }
-        addr++;
-    }
-    return 1;  // No colon found, likely an IPv4 address
-}
+int resolve_single(args_t* args, struct resolver* resolver) {
+    char name[MAX_NAME] = { 0 };
+    get_query_name(args, args->target_addr, name);
 
-/**
- * @brief Count the number of compressed sections in an IPv6 address.
- *
- * This function takes an IPv6 address as input and counts the number of compressed
- * sections in the address.
- *
- * @param addr Pointer to the IPv6 address to be analyzed.
- * @return The number of compressed sections in the IPv6 address.
- */
-int compressed_sections_ipv6(char* addr) {
-    // Count of sections (default = 1)
-    int sections = 1;
+    unsigned short qtypes[MAX_QTYPES];
+    int nqtypes = get_query_types(args, qtypes);
 
-    // Create a buffer to store a copy of the original address for tokenization with strtok
-    char buff[MAX_BUFF] = { 0 };
+    single_result_t results[MAX_QTYPES];
+    memset(results, 0, sizeof(results));
 
-    // Copy the content of the original address to the buffer
-    strcpy(buff, addr);
+    for (int i = 0; i < nqtypes; i++) {
+        if (resolver_submit(resolver, name, qtypes[i], store_single, &results[i])) {
+            return E_EAI;
+        }
+    }
 
-    // Tokenize the buffer using colons as delimiters
-    char* token = strtok(buff, ":");
+    while (resolver_pending(resolver) > 0) {
+        int run_err_code = resolver_run(resolver, -1);
+        if (run_err_code) {
+            return run_err_code;
+        }
+    }
 
-    // Iterate through the remaining tokens to count the number of sections
-    while ((token = strtok(NULL, ":")) != NULL) sections++;
+    int err_code = 0;
+    for (int i = 0; i < nqtypes; i++) {
+        int err = print_target(args, i + 1, results[i].err, results[i].packet, results[i].len);
+        err_code = err_code ? err_code : err;
+        free(results[i].packet);
+    }
 
-    return sections;
+    return err_code;
 }
 
 /**
- * @brief Create a reverse DNS domain name for an IPv6 address.
+ * @brief Resolve the address of a DNS server specified by the user.
  *
- * This function generates a reverse DNS domain name for the given IPv6 address and
- * stores it in the 'dest' buffer.
+ * This function translates an address of the `-s` option into a socket address (including the port), so it
+ * can be used for any number of queries without calling getaddrinfo again. On failure the
+ * program is terminated with the corresponding error code.
  *
- * @param dest Pointer to the destination buffer where the reverse DNS domain name will be stored.
- * @param addr Pointer to the IPv6 address to be reversed.
+ * @param args Pointer to the program's command-line arguments.
+ * @param addr IP address or domain name of the server.
+ * @param server Pointer to the structure where the server address will be stored.
  */
-void reverse_dns_ipv6(char* dest, char* addr) {
-    for (int i = strlen(addr) - 1, j = 0; i >= 0; i--) {
-
-        // Copy existing section
-        while (i >= 0 && addr[i] != ':') {
-            dest[j++] = addr[i--];
-            dest[j++] = '.';
-        }
+void resolve_server(args_t* args, const char* addr, dns_server_t* server) {
+    struct addrinfo hints, *res;        // Hints and result list for getaddrinfo
 
-        // Calculate number of missed zeros in a section
-        int miss = (int)(j / 2) % MAX_IPV6_SECTION_LENGTH;
-        int zeros = miss > 0 ? MAX_IPV6_SECTION_LENGTH - miss : 0;
+    memset(&hints, 0, sizeof(struct addrinfo));   // Reset hints
+    hints.ai_family = AF_UNSPEC;        // Allow IPV6 or IPV4
+    hints.ai_socktype = SOCK_DGRAM;     // UDP
 
-        // Detect compression
-        if (i > 0 && addr[i] == ':' && addr[i - 1] == ':') {
-            zeros = MAX_IPV6_SECTION_LENGTH * (MAX_IPV6_SECTIONS - compressed_sections_ipv6(addr));
+    // Get ip address of a specified dns server
+    int err = getaddrinfo(addr, args->port, &hints, &res);
+    if (err) {
+        if (err == EAI_SYSTEM){
+            exit_error(E_EAI, strerror(errno));
         }
+        else{
+            exit_error(E_GAI, gai_strerror(err));
+        }
+    }
 
-        // Add compressed zeros
-        for (int l = 0; l < zeros; l++) {
-            dest[j++] = '0';
-            dest[j++] = '.';
-        } 
+    if (res->ai_family != AF_INET6 && res->ai_family != AF_INET) {
+        freeaddrinfo(res);
+        exit_error(E_FAMILY, "Unsupported address family");
     }
 
-    // Add ipv6 prefix
-    strcat((char*)dest, IPV6_REVERSE_PREFIX);
-}
\ No newline at end of file
+    // Save address of a dns server (port is already filled in by getaddrinfo)
+    memset(server, 0, sizeof(dns_server_t));
+    memcpy(&server->addr, res->ai_addr, res->ai_addrlen);
+    server->addr_len = res->ai_addrlen;
+    server->family = res->ai_family;
+
+    // Clean up getaddrinfo
+    freeaddrinfo(res);
+}
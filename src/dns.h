@@ -5,8 +5,8 @@
  * This C header file, "dns.h," defines data structures and function prototypes used in
  * the DNS query utility. It includes structures for DNS header, resource records, question
  * sections, and SOA (Start of Authority) resource data. Additionally, it provides function
- * declarations for DNS query creation, DNS query sending, parsing DNS responses, and various
- * utility functions for working with DNS data.
+ * declarations for DNS query creation (query.c), parsing and printing DNS responses
+ * (response.c), and various utility functions for working with DNS data.
  *
  * @author Oleksandr Turytsia (xturyt00)
  * @date October 18, 2023
@@ -20,8 +20,10 @@
 
 #define MAX_BUFF 65536
 #define MAX_NAME 256
-#define MAX_IPV6_SECTIONS 8
-#define MAX_IPV6_SECTION_LENGTH 4
+#define MAX_WIRE_NAME 255
+#define MAX_LABEL 63
+#define MAX_HOST_BITS 31
+#define MAX_POINTERS 127
 
 #define IPV4_REVERSE_PREFIX "in-addr.arpa"
 #define IPV6_REVERSE_PREFIX "ip6.arpa"
@@ -79,21 +81,57 @@ typedef struct {
 } dns_soa_t;
 #pragma pack()
 
-void parse_domain_name(unsigned char* packet, unsigned char* buffer, char* result);
-void create_dns_query(args_t* args, unsigned char* query);
-send_query_err_t send_dns_query(args_t* args, int ai_family, unsigned char* buffer, unsigned char* query, char* addr, int qlen);
-void compress(unsigned char* dest, char* src, int len);
-void compress_domain_name(unsigned char* dest, char* src);
-
-void print_rr(unsigned char* pointer, unsigned char* buffer, int n, int is_test);
-int compressed_sections_ipv6(char* addr);
-void reverse_dns_ipv6(char* dest, char* addr);
-void reverse_dns_ipv4(char* dest, char* addr);
-int is_ipv4(char* addr);
-
-void print_ipv4_data(unsigned char* pointer);
-void print_ipv6_data(unsigned char* pointer);
-void print_soa_data(unsigned char* pointer, unsigned char* buffer);
-void print_domain_name_data(unsigned char* pointer, unsigned char* buffer);
+// Resolved DNS server
+typedef struct {
+    struct sockaddr_storage addr;   // Address of the server (including port)
+    socklen_t addr_len;             // Length of the address
+    int family;                     // Address family (AF_INET or AF_INET6)
+} dns_server_t;
+
+// Range of addresses (CIDR notation)
+typedef struct {
+    int family;                     // Address family (AF_INET or AF_INET6)
+    int len;                        // Length of an address in bytes
+    unsigned char addr[16];         // First address of the range (network byte order)
+    int prefix;                     // Length of the prefix in bits
+    unsigned long long count;       // Number of addresses in the range
+} cidr_t;
+
+// Result of a query of the single target (one query per type)
+typedef struct {
+    int err;                        // Error code of the query
+    unsigned char* packet;          // Copy of the response (NULL on error)
+    int len;                        // Length of the response
+} single_result_t;
+
+struct resolver;
+struct cache;
+struct capture;
+struct dns_message;
+struct dns_record;
+
+void resolve_server(args_t* args, const char* addr, dns_server_t* server);
+int get_window(args_t* args);
+int setup_resolver(struct resolver* resolver, args_t* args, dns_server_t* servers, struct cache* cache, struct capture* capture);
+int resolve_single(args_t* args, struct resolver* resolver);
+int resolve_cached(args_t* args, struct cache* cache);
+void free_cache(struct cache* cache);
+int print_response(unsigned char* buffer, int len, int is_test);
+
+int parse_domain_name(unsigned char* buffer, int len, int offset, char* result);
+int create_dns_query(unsigned char* query, const char* name, unsigned short qtype, int recursive, int lowercase, unsigned short id, int edns,
+                     int* qname_size);
+void get_query_name(args_t* args, const char* target, char* dest);
+unsigned short get_query_type(args_t* args);
+int get_query_types(args_t* args, unsigned short* qtypes);
+int encode_domain_name(unsigned char* dest, const char* name, int lowercase);
+
+int print_record(struct dns_message* message, struct dns_record* record, int is_test);
+int reverse_dns_ipv6(char* dest, const unsigned char* addr);
+int reverse_dns_ipv4(char* dest, const unsigned char* addr);
+int parse_cidr(const char* text, cidr_t* cidr);
+void get_cidr_address(cidr_t* cidr, unsigned long long index, unsigned char* addr);
+
+void print_opt_data(unsigned char* pointer);
 
 #endif
\ No newline at end of file
@@ -24,4 +24,77 @@
 void exit_error(int err, const char* message) {
     fprintf(stderr, "Error: %s\n", message);
     exit(err);
+}
+
+/**
+ * @brief Get a descriptive message for an error code.
+ *
+ * This function translates error codes defined in error.h into human-readable messages, so
+ * the same message can be used both for fatal errors and for errors of a single query in
+ * batch mode.
+ *
+ * @param err The error code.
+ * @return A descriptive error message.
+ */
+const char* get_error_message(int err) {
+    switch (err) {
+        case E_UNKNOWN_OPT:
+            return "Unknown option";
+        case E_PORT_INV:
+            return "Port is not valid (1-65535)";
+        case E_PORT_MISS:
+            return "Port is missing for the option -p";
+        case E_SRC_MISS:
+            return "Source address is missing for the options -s";
+        case E_TGT_MISS:
+            return "Target address is not specified";
+        case E_OPT_DOUBLE:
+            return "You have specified the same option twice";
+        case E_FILE_MISS:
+            return "File is missing for the option -f";
+        case E_VALUE_MISS:
+            return "Value is missing for the option";
+        case E_VALUE_INV:
+            return "Value of the option is not valid";
+        case E_SRC_MANY:
+            return "Too many servers for the option -s (max 8)";
+        case E_SOCK:
+            return "Socket creation failed";
+        case E_SENDTO:
+            return "DNS query sendto failed";
+        case E_TIMEOUT:
+            return "Receive timeout reached. No data received";
+        case E_RECVFROM:
+            return "DNS query recvfrom failed";
+        case E_FAMILY:
+            return "Unsupported address family";
+        case E_FILE:
+            return "Input file could not be opened";
+        case E_QNAME:
+            return "Domain name is not valid";
+        case E_CACHE_FILE:
+            return "Cache file could not be opened or is not a cache file";
+        case E_LISTEN:
+            return "Listening socket could not be created";
+        case E_RANGE:
+            return "Address range is not valid";
+        case E_CAPTURE_FILE:
+            return "Capture file could not be opened";
+        case E_TRACE:
+            return "Iterative resolution failed";
+        case E_CHAIN:
+            return "CNAME chain is too long or contains a loop";
+        case E_FORMAT:
+            return "RCODE 1, Format error";
+        case E_SERVER_FAIL:
+            return "RCODE 2, Server failure";
+        case E_NAME:
+            return "RCODE 3, Name error";
+        case E_NOT_IMPL:
+            return "RCODE 4, Not implemented";
+        case E_REFUSED:
+            return "RCODE 5, Refused";
+        default:
+            return "Unknown error";
+    }
 }
\ No newline at end of file
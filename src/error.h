@@ -6,7 +6,7 @@
  * in a DNS query utility. It includes error code enumerations for different types of
  * errors, such as command-line argument validation, DNS query sending, address resolution,
  * and DNS response handling. The file also provides a function to report and handle errors
- * with descriptive error messages.
+ * with descriptive error messages and a function to translate error codes into messages.
  *
  * @author Oleksandr Turytsia (xturyt00)
  * @date October 18, 2023
@@ -22,7 +22,11 @@ typedef enum {
     E_PORT_MISS = 3,
     E_SRC_MISS = 4,
     E_TGT_MISS = 5,
-    E_OPT_DOUBLE = 6
+    E_OPT_DOUBLE = 6,
+    E_FILE_MISS = 7,
+    E_VALUE_MISS = 8,
+    E_VALUE_INV = 9,
+    E_SRC_MANY = 14
 } args_err_t;
 
 typedef enum {
@@ -36,6 +40,14 @@ typedef enum {
     E_EAI = 20,
     E_GAI = 21,
     E_FAMILY = 22,
+    E_FILE = 23,
+    E_QNAME = 24,
+    E_CACHE_FILE = 25,
+    E_LISTEN = 26,
+    E_RANGE = 27,
+    E_CAPTURE_FILE = 28,
+    E_TRACE = 29,
+    E_CHAIN = 30,
 } other_err_t;
 
 typedef enum {
@@ -47,5 +59,6 @@ typedef enum {
 } rcode_err_t;
 
 void exit_error(int err, const char* message);
+const char* get_error_message(int err);
 
 #endif
\ No newline at end of file
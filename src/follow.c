@@ -0,0 +1,319 @@
+/**
+ * @file follow.c
+ * @brief Address Lookup Implementation
+ *
+ * This C source file, "follow.c" contains the implementation of the address lookup mode. Every
+ * host has two lookups (A and AAAA) submitted to the resolver at once, so both families are
+ * resolved in a single round trip. Once both lookups are finished, aliases of the chain are
+ * printed followed by the final addresses in the standard record format.
+ *
+ * @author Oleksandr Turytsia (xturyt00)
+ * @date October 18, 2023
+ */
+#include "follow.h"
+#include "batch.h"
+
+/**
+ * @brief Check whether a name is in the chain of a lookup.
+ *
+ * @param lookup Lookup of the host.
+ * @param name Name in the presentation format (with the trailing dot).
+ * @return 1 if the name was already visited, 0 otherwise.
+ */
+static int is_visited(follow_lookup_t* lookup, const char* name) {
+    for (int i = 0; i < lookup->nnames; i++) {
+        if (strcasecmp(lookup->names[i], name) == 0) {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Find a record of the answer section by its owner and type.
+ *
+ * @param message Parsed response.
+ * @param name Owner name in the presentation format (with the trailing dot).
+ * @param type Type of the record.
+ * @return Record, or NULL if there is no such record.
+ */
+static dns_record_t* find_answer(dns_message_t* message, const char* name, unsigned short type) {
+    char owner[MAX_NAME];
+
+    for (int i = 0; i < message->counts[SECTION_ANSWER]; i++) {
+        dns_record_t* record = &message->records[i];
+
+        if (record->type == type && parse_domain_name(message->packet, message->len, record->name, owner) != -1 &&
+            strcasecmp(owner, name) == 0) {
+            return record;
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief Print the result of a host and release its context.
+ *
+ * @param follow Pointer to the state of the address lookup mode.
+ * @param host Host with both lookups finished.
+ */
+static void print_host(follow_t* follow, follow_host_t* host) {
+    follow_lookup_t* lookups = host->lookups;
+
+    if (follow->tagged) {
+        printf("Host (%d): %s\n", host->index, host->target);
+    }
+
+    // Aliases are the same for both families, the longer chain is the more complete one
+    follow_lookup_t* chain = lookups[1].nnames > lookups[0].nnames ? &lookups[1] : &lookups[0];
+    for (int i = 1; i < chain->nnames; i++) {
+        printf(" %s, CNAME, IN, %d, %s\n", chain->names[i - 1], follow->args->test ? 0 : chain->ttls[i - 1], chain->names[i]);
+    }
+
+    // Addresses of the last alias
+    int err = 0;
+    for (int i = 0; i < 2; i++) {
+        follow_lookup_t* lookup = &lookups[i];
+
+        if (lookup->err) {
+            err = err ? err : lookup->err;
+            continue;
+        }
+
+        if (lookup->packet == NULL || parse_message(follow->message, lookup->packet, lookup->len)) {
+            continue;
+        }
+
+        const char* name = lookup->names[lookup->nnames - 1];
+        char owner[MAX_NAME];
+
+        for (int j = 0; j < follow->message->counts[SECTION_ANSWER]; j++) {
+            dns_record_t* record = &follow->message->records[j];
+
+            if (record->type == lookup->qtype && parse_domain_name(lookup->packet, lookup->len, record->name, owner) != -1 &&
+                strcasecmp(owner, name) == 0) {
+                print_record(follow->message, record, follow->args->test);
+            }
+        }
+    }
+
+    // A host is resolved if at least one family succeeded, the error of a single target is printed by the caller
+    if (err && (lookups[0].err || lookups[0].packet == NULL) && (lookups[1].err || lookups[1].packet == NULL)) {
+        if (follow->tagged) {
+            printf("Error: %s\n", get_error_message(err));
+        }
+        follow->result = err;
+    }
+
+    for (int i = 0; i < 2; i++) {
+        free(lookups[i].packet);
+        lookups[i].packet = NULL;
+    }
+
+    follow->free[follow->nfree++] = host;
+}
+
+/**
+ * @brief Finish a lookup and print its host once both lookups are finished.
+ *
+ * @param follow Pointer to the state of the address lookup mode.
+ * @param lookup Finished lookup.
+ * @param err Error code of the lookup (0 on success).
+ */
+static void finish_lookup(follow_t* follow, follow_lookup_t* lookup, int err) {
+    lookup->err = err;
+
+    if (--lookup->host->pending == 0) {
+        print_host(follow, lookup->host);
+    }
+}
+
+/**
+ * @brief Follow the CNAME chain of a response.
+ *
+ * Callback of the resolver. Aliases of the answer section are followed from the last name of the
+ * chain. If the answer has records of the queried type for the last alias, the lookup is
+ * finished, if the chain ends with an alias that the server did not resolve, the query is sent
+ * again for the alias.
+ *
+ * @param resolver Pointer to the resolver.
+ * @param result Result of the query.
+ * @param data Lookup of the query.
+ */
+static void follow_answer(resolver_t* resolver, resolver_result_t* result, void* data) {
+    follow_t* follow = resolver->data;
+    follow_lookup_t* lookup = data;
+
+    if (result->err) {
+        finish_lookup(follow, lookup, result->err);
+        return;
+    }
+
+    // RFC 1035 response codes 1-5 are mapped to error codes 31-35
+    int rcode = ((dns_header_t*)result->packet)->rcode;
+    if (rcode >= RCODE_FORMAT_ERROR && rcode <= RCODE_REFUCED) {
+        finish_lookup(follow, lookup, E_FORMAT + rcode - RCODE_FORMAT_ERROR);
+        return;
+    }
+
+    if (parse_message(follow->message, result->packet, result->len)) {
+        finish_lookup(follow, lookup, E_FORMAT);
+        return;
+    }
+
+    int start = lookup->nnames;
+
+    while (find_answer(follow->message, lookup->names[lookup->nnames - 1], lookup->qtype) == NULL) {
+        dns_record_t* alias = find_answer(follow->message, lookup->names[lookup->nnames - 1], CNAME);
+        if (alias == NULL) {
+            break;
+        }
+
+        char target[MAX_NAME];
+        if (parse_domain_name(result->packet, result->len, alias->rdata, target) == -1) {
+            finish_lookup(follow, lookup, E_FORMAT);
+            return;
+        }
+
+        if (lookup->nnames == MAX_CHAIN + 1 || is_visited(lookup, target)) {
+            finish_lookup(follow, lookup, E_CHAIN);
+            return;
+        }
+
+        lookup->ttls[lookup->nnames - 1] = alias->ttl;
+        strcpy(lookup->names[lookup->nnames++], target);
+    }
+
+    // Chain ends with an alias the server did not resolve
+    if (lookup->nnames > start && find_answer(follow->message, lookup->names[lookup->nnames - 1], lookup->qtype) == NULL) {
+        if (resolver_submit(resolver, lookup->names[lookup->nnames - 1], lookup->qtype, follow_answer, lookup)) {
+            finish_lookup(follow, lookup, E_EAI);
+        }
+        return;
+    }
+
+    lookup->packet = malloc(result->len);
+    if (lookup->packet == NULL) {
+        exit_error(E_EAI, strerror(errno));
+    }
+    memcpy(lookup->packet, result->packet, result->len);
+    lookup->len = result->len;
+
+    finish_lookup(follow, lookup, 0);
+}
+
+/**
+ * @brief Start lookups of both address families of a host.
+ *
+ * @param follow Pointer to the state of the address lookup mode.
+ * @param resolver Pointer to the resolver.
+ * @param host Context of the host with its target set.
+ */
+static void start_host(follow_t* follow, resolver_t* resolver, follow_host_t* host) {
+    static const unsigned short qtypes[2] = { A, AAAA };
+
+    host->pending = 2;
+
+    for (int i = 0; i < 2; i++) {
+        follow_lookup_t* lookup = &host->lookups[i];
+
+        lookup->host = host;
+        lookup->qtype = qtypes[i];
+        lookup->nnames = 1;
+        lookup->err = 0;
+        lookup->packet = NULL;
+        lookup->len = 0;
+
+        // Names of the chain are absolute, as parsed from responses
+        int len = strlen(host->target);
+        snprintf(lookup->names[0], MAX_NAME, len > 0 && host->target[len - 1] == '.' ? "%s" : "%s.", host->target);
+    }
+
+    for (int i = 0; i < 2; i++) {
+        if (resolver_submit(resolver, host->target, qtypes[i], follow_answer, &host->lookups[i])) {
+            finish_lookup(follow, &host->lookups[i], E_EAI);
+        }
+    }
+}
+
+/**
+ * @brief Look up addresses of the target address, or of every name from the input file.
+ *
+ * Hosts are looked up concurrently, up to half of `--inflight` hosts at a time (both families
+ * of a host are outstanding at once). Results of the batch mode are printed in the order in which
+ * hosts are finished, tagged by `Host (N): name`.
+ *
+ * @param args Pointer to the program's command-line arguments.
+ * @param resolver Pointer to the resolver.
+ * @return 0 if all hosts were resolved, otherwise the error code of the last failed host.
+ */
+int run_follow(args_t* args, resolver_t* resolver) {
+    int batch = strlen(args->file) != 0;
+    FILE* input = NULL;
+
+    if (batch) {
+        input = strcmp(args->file, "-") == 0 ? stdin : fopen(args->file, "r");
+        if (input == NULL) {
+            exit_error(E_FILE, get_error_message(E_FILE));
+        }
+    }
+
+    int count = resolver->config.window / 2 > 1 ? resolver->config.window / 2 : 1;
+
+    follow_t follow = { .args = args, .tagged = batch, .result = 0 };
+    follow.message = malloc(sizeof(dns_message_t));
+    follow.hosts = malloc(count * sizeof(follow_host_t));
+    follow.free = malloc(count * sizeof(follow_host_t*));
+    if (follow.message == NULL || follow.hosts == NULL || follow.free == NULL) {
+        exit_error(E_EAI, strerror(errno));
+    }
+
+    for (int i = 0; i < count; i++) {
+        follow.free[follow.nfree++] = &follow.hosts[i];
+    }
+
+    resolver->data = &follow;
+
+    int index = 0;
+    int done = 0;
+
+    while (1) {
+        while (!done && follow.nfree > 0) {
+            follow_host_t* host = follow.free[follow.nfree - 1];
+
+            if (batch ? !read_name(input, host->target) : index > 0) {
+                done = 1;
+                break;
+            }
+
+            if (!batch) {
+                strcpy(host->target, args->target_addr);
+            }
+
+            follow.nfree--;
+            host->index = ++index;
+            start_host(&follow, resolver, host);
+        }
+
+        if (resolver_pending(resolver) == 0) {
+            break;
+        }
+
+        int err_code = resolver_run(resolver, -1);
+        if (err_code) {
+            exit_error(err_code, get_error_message(err_code));
+        }
+    }
+
+    if (input != NULL && input != stdin) {
+        fclose(input);
+    }
+
+    free(follow.message);
+    free(follow.hosts);
+    free(follow.free);
+
+    return follow.result;
+}
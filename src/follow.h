@@ -0,0 +1,58 @@
+/**
+ * @file follow.h
+ * @brief Address Lookup Header
+ *
+ * This C header file, "follow.h" declares the address lookup mode (`--follow`). The A and AAAA
+ * queries of a host are sent at the same time and CNAME chains of their answers are followed to
+ * the final addresses. If a server returns only a part of the chain, the query is sent again for
+ * the last alias. Chains are limited to MAX_CHAIN aliases and loops are detected.
+ *
+ * @author Oleksandr Turytsia (xturyt00)
+ * @date October 18, 2023
+ */
+#ifndef FOLLOW_H
+#define FOLLOW_H
+
+#include "dns.h"
+#include "resolver.h"
+#include "parse.h"
+
+#define MAX_CHAIN 8
+#define FOLLOW_WINDOW 2
+
+typedef struct follow_host follow_host_t;
+
+// Lookup of a single address family of a host
+typedef struct {
+    follow_host_t* host;            // Host of the lookup
+    unsigned short qtype;           // Type of the queries (A or AAAA)
+    char names[MAX_CHAIN + 1][MAX_NAME];  // Queried name followed by targets of aliases
+    unsigned int ttls[MAX_CHAIN];   // TTLs of aliases
+    int nnames;                     // Number of names in the chain
+    int err;                        // Error code of the lookup (0 on success)
+    unsigned char* packet;          // Copy of the final response (NULL if there is none)
+    int len;                        // Length of the final response
+} follow_lookup_t;
+
+// Host being looked up
+struct follow_host {
+    int index;                      // Index of the host in the input (starting from 1)
+    char target[MAX_NAME];          // Name as specified in the input
+    int pending;                    // Number of unfinished lookups
+    follow_lookup_t lookups[2];     // Lookups of A and AAAA records
+};
+
+// State of the address lookup mode
+typedef struct {
+    args_t* args;                   // Program arguments
+    int tagged;                     // Results are tagged by `Host (N): name` (batch mode)
+    int result;                     // Error code of the last failed host
+    dns_message_t* message;         // Record index of the last response
+    follow_host_t* hosts;           // Contexts of hosts
+    follow_host_t** free;           // Contexts of finished hosts
+    int nfree;                      // Number of free contexts
+} follow_t;
+
+int run_follow(args_t* args, resolver_t* resolver);
+
+#endif
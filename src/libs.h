@@ -1,7 +1,7 @@
 #ifndef LIBS_H
 #define LIBS_H
 
-#define _POSIX_C_SOURCE 200112L
+#define _GNU_SOURCE
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -14,5 +14,17 @@
 #include <ctype.h>
 #include <errno.h>
 #include <sys/time.h>
+#include <sys/epoll.h>
+#include <time.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <signal.h>
+#include <sched.h>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/random.h>
+#include <sys/timerfd.h>
 
 #endif
\ No newline at end of file
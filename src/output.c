@@ -0,0 +1,228 @@
+/**
+ * @file output.c
+ * @brief Machine-Readable Output Implementation
+ *
+ * This C source file, "output.c" contains the implementation of the JSON Lines and binary output
+ * formats. Responses are walked once by the parse stage (see parse.h) and records are formatted
+ * from the record index directly into the buffer of the writer.
+ *
+ * @author Oleksandr Turytsia (xturyt00)
+ * @date October 18, 2023
+ */
+#include "output.h"
+#include "rdata.h"
+
+/**
+ * @brief Write RDATA of a record in presentation format as a JSON string.
+ *
+ * RDATA is decoded by the registry of record types (see rdata.h), RDATA of unknown types is
+ * written in the generic format of RFC 3597 (`\# length hex`).
+ *
+ * @param writer Pointer to the writer.
+ * @param message Parsed message.
+ * @param record Record of the message.
+ */
+static void write_rdata(writer_t* writer, dns_message_t* message, dns_record_t* record) {
+    char small[RDATA_SMALL];
+    char* data = format_rdata(small, sizeof(small), message->packet, message->len, record->type, record->rdata, record->rdlength, " ");
+
+    writer_json_string(writer, data);
+
+    if (data != small) {
+        free(data);
+    }
+}
+
+/**
+ * @brief Write a domain name from a packet as a JSON string.
+ *
+ * @param writer Pointer to the writer.
+ * @param message Parsed message.
+ * @param offset Offset of the name.
+ */
+static void write_name(writer_t* writer, dns_message_t* message, int offset) {
+    char name[MAX_NAME];
+
+    if (parse_domain_name(message->packet, message->len, offset, name) == -1) {
+        name[0] = 0;
+    }
+
+    writer_json_string(writer, name);
+}
+
+/**
+ * @brief Write a failed query as a JSON object.
+ *
+ * @param writer Pointer to the writer.
+ * @param index Index of the query.
+ * @param target Target of the query as specified by the user.
+ * @param err Error code of the query.
+ */
+static void write_json_error(writer_t* writer, unsigned int index, const char* target, int err) {
+    writer_puts(writer, "{\"index\":");
+    writer_uint(writer, index);
+    writer_puts(writer, ",\"target\":");
+    writer_json_string(writer, target);
+    writer_puts(writer, ",\"error\":");
+    writer_uint(writer, err);
+    writer_puts(writer, ",\"message\":");
+    writer_json_string(writer, get_error_message(err));
+    writer_puts(writer, "}\n");
+}
+
+/**
+ * @brief Write a response as a JSON object.
+ *
+ * @param writer Pointer to the writer.
+ * @param index Index of the query.
+ * @param target Target of the query as specified by the user.
+ * @param packet Response packet.
+ * @param len Length of the response packet.
+ * @param is_test Hide TTL values (testing mode).
+ * @return 0 on success, E_FORMAT if the response is malformed (nothing is written).
+ */
+static int write_json(writer_t* writer, unsigned int index, const char* target, unsigned char* packet, int len, int is_test) {
+    static const char* sections[] = { "answer", "authority", "additional" };
+    dns_message_t message;
+
+    if (parse_message(&message, packet, len)) {
+        return E_FORMAT;
+    }
+
+    dns_header_t* header = (dns_header_t*)packet;
+
+    writer_puts(writer, "{\"index\":");
+    writer_uint(writer, index);
+    writer_puts(writer, ",\"target\":");
+    writer_json_string(writer, target);
+    writer_puts(writer, ",\"id\":");
+    writer_uint(writer, ntohs(header->id));
+    writer_puts(writer, ",\"rcode\":");
+    writer_uint(writer, header->rcode);
+    writer_puts(writer, header->aa ? ",\"aa\":true" : ",\"aa\":false");
+    writer_puts(writer, header->tc ? ",\"tc\":true" : ",\"tc\":false");
+    writer_puts(writer, header->rd ? ",\"rd\":true" : ",\"rd\":false");
+    writer_puts(writer, header->ra ? ",\"ra\":true" : ",\"ra\":false");
+
+    // Every question is QNAME followed by QTYPE and QCLASS (validated by the parser)
+    int offset = sizeof(dns_header_t);
+
+    writer_puts(writer, ",\"questions\":[");
+
+    for (int i = 0; i < message.qdcount; i++) {
+        int end = skip_domain_name(packet, len, offset);
+        dns_question_t* question = (dns_question_t*)(packet + end);
+
+        writer_puts(writer, i == 0 ? "{\"name\":" : ",{\"name\":");
+        write_name(writer, &message, offset);
+        writer_puts(writer, ",\"type\":");
+        writer_uint(writer, ntohs(question->qtype));
+        writer_puts(writer, ",\"class\":");
+        writer_uint(writer, ntohs(question->qclass));
+        writer_char(writer, '}');
+
+        offset = end + sizeof(dns_question_t);
+    }
+
+    writer_char(writer, ']');
+
+    // Records are stored in the order of sections
+    int record = 0;
+
+    for (int section = SECTION_ANSWER; section <= SECTION_ADDITIONAL; section++) {
+        writer_puts(writer, ",\"");
+        writer_puts(writer, sections[section]);
+        writer_puts(writer, "\":[");
+
+        for (int i = 0; i < message.counts[section]; i++, record++) {
+            dns_record_t* rr = &message.records[record];
+
+            writer_puts(writer, i == 0 ? "{\"name\":" : ",{\"name\":");
+            write_name(writer, &message, rr->name);
+            writer_puts(writer, ",\"type\":");
+            writer_uint(writer, rr->type);
+            writer_puts(writer, ",\"class\":");
+            writer_uint(writer, rr->class);
+            writer_puts(writer, ",\"ttl\":");
+            writer_uint(writer, is_test ? 0 : rr->ttl);
+            writer_puts(writer, ",\"data\":");
+            write_rdata(writer, &message, rr);
+            writer_char(writer, '}');
+        }
+
+        writer_char(writer, ']');
+    }
+
+    writer_puts(writer, "}\n");
+
+    return 0;
+}
+
+/**
+ * @brief Write a result as a binary record.
+ *
+ * @param writer Pointer to the writer.
+ * @param index Index of the query.
+ * @param err Error code of the query.
+ * @param packet Response packet.
+ * @param len Length of the response packet (ignored on error).
+ */
+static void write_binary(writer_t* writer, unsigned int index, int err, unsigned char* packet, int len) {
+    if (err) {
+        len = 0;
+    }
+
+    unsigned char prefix[8] = {
+        index >> 24, index >> 16, index >> 8, index,
+        err >> 8, err,
+        len >> 8, len
+    };
+
+    writer_write(writer, prefix, sizeof(prefix));
+
+    if (len > 0) {
+        writer_write(writer, packet, len);
+    }
+}
+
+/**
+ * @brief Write the result of a query in a machine-readable format.
+ *
+ * Responses with RCODE 1-5 are written as well, so the response code is available to the
+ * consumer, but they are reported as errors the same way as by `print_response`.
+ *
+ * @param writer Pointer to the writer.
+ * @param format Output format (FORMAT_JSONL or FORMAT_BINARY).
+ * @param index Index of the query.
+ * @param target Target of the query as specified by the user.
+ * @param err Error code of the query (0 on success).
+ * @param packet Response packet.
+ * @param len Length of the response packet.
+ * @param is_test Hide TTL values (testing mode).
+ * @return Error code of the query (including response code errors).
+ */
+int write_result(writer_t* writer, int format, unsigned int index, const char* target, int err, unsigned char* packet, int len, int is_test) {
+    if (!err && len < (int)sizeof(dns_header_t)) {
+        err = E_FORMAT;
+    }
+
+    if (format == FORMAT_BINARY) {
+        write_binary(writer, index, err, packet, len);
+    }
+    else if (err || (err = write_json(writer, index, target, packet, len, is_test))) {
+        write_json_error(writer, index, target, err);
+        return err;
+    }
+
+    if (err) {
+        return err;
+    }
+
+    // RFC 1035 response codes 1-5 are mapped to error codes 31-35
+    int rcode = ((dns_header_t*)packet)->rcode;
+    if (rcode >= RCODE_FORMAT_ERROR && rcode <= RCODE_REFUCED) {
+        return E_FORMAT + rcode - RCODE_FORMAT_ERROR;
+    }
+
+    return 0;
+}
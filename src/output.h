@@ -0,0 +1,25 @@
+/**
+ * @file output.h
+ * @brief Machine-Readable Output Header
+ *
+ * This C header file, "output.h" declares the machine-readable output formats selected by the
+ * `--format` option. Every result is written as a single record through a buffered writer:
+ *
+ * - JSON Lines: one JSON object per result with the header flags, the question and all records of
+ *   the answer, authority and additional sections (RDATA as a presentation format string).
+ * - Binary: `index (u32) | error (u16) | length (u16) | response`, big-endian, the response is
+ *   the raw DNS message (length 0 if the query failed).
+ *
+ * @author Oleksandr Turytsia (xturyt00)
+ * @date October 18, 2023
+ */
+#ifndef OUTPUT_H
+#define OUTPUT_H
+
+#include "dns.h"
+#include "parse.h"
+#include "writer.h"
+
+int write_result(writer_t* writer, int format, unsigned int index, const char* target, int err, unsigned char* packet, int len, int is_test);
+
+#endif
@@ -0,0 +1,129 @@
+/**
+ * @file parse.c
+ * @brief Response Parsing Stage Implementation
+ *
+ * This C source file, "parse.c" contains the parse stage of DNS messages. The header, the question
+ * section and all resource records are validated against the length of the packet in a single
+ * pass and stored in a record index (see parse.h).
+ *
+ * @author Oleksandr Turytsia (xturyt00)
+ * @date October 18, 2023
+ */
+#include "parse.h"
+
+/**
+ * @brief Skip a domain name in a packet.
+ *
+ * Compression pointers are not followed, a pointer ends the name.
+ *
+ * @param packet DNS packet.
+ * @param len Length of the packet.
+ * @param offset Offset of the name.
+ * @return Offset after the name, or -1 if the name exceeds the packet.
+ */
+int skip_domain_name(unsigned char* packet, int len, int offset) {
+    while (offset < len) {
+        unsigned char label = packet[offset];
+
+        if (label == 0) {
+            return offset + 1;
+        }
+
+        // Compression pointer ends the name
+        if ((label & 192) == 192) {
+            return offset + 2 <= len ? offset + 2 : -1;
+        }
+
+        // Label types 01 and 10 are not used
+        if (label & 192) {
+            return -1;
+        }
+
+        offset += label + 1;
+    }
+
+    return -1;
+}
+
+/**
+ * @brief Parse a DNS message into a record index.
+ *
+ * @param message Where the index will be stored.
+ * @param packet DNS packet, it must stay valid while the index is used.
+ * @param len Length of the packet.
+ * @return 0 on success, -1 if the message is malformed or has more than MAX_RECORDS records.
+ */
+int parse_message(dns_message_t* message, unsigned char* packet, int len) {
+    if (len < (int)sizeof(dns_header_t) || len > MAX_BUFF - 1) {
+        return -1;
+    }
+
+    dns_header_t* header = (dns_header_t*)packet;
+
+    message->packet = packet;
+    message->len = len;
+    message->qdcount = ntohs(header->qdcount);
+    message->counts[SECTION_ANSWER] = ntohs(header->ancount);
+    message->counts[SECTION_AUTHORITY] = ntohs(header->nscount);
+    message->counts[SECTION_ADDITIONAL] = ntohs(header->arcount);
+    message->nrecords = 0;
+    message->qname = 0;
+    message->qtype = 0;
+    message->qclass = 0;
+
+    int offset = sizeof(dns_header_t);
+
+    // Question section
+    for (int i = 0; i < message->qdcount; i++) {
+        int end = skip_domain_name(packet, len, offset);
+        if (end == -1 || end + (int)sizeof(dns_question_t) > len) {
+            return -1;
+        }
+
+        if (i == 0) {
+            dns_question_t* question = (dns_question_t*)(packet + end);
+            message->qname = offset;
+            message->qtype = ntohs(question->qtype);
+            message->qclass = ntohs(question->qclass);
+        }
+
+        offset = end + sizeof(dns_question_t);
+    }
+
+    // Answer, authority and additional sections
+    for (int section = SECTION_ANSWER; section <= SECTION_ADDITIONAL; section++) {
+        for (int i = 0; i < message->counts[section]; i++) {
+            if (message->nrecords == MAX_RECORDS) {
+                return -1;
+            }
+
+            int end = skip_domain_name(packet, len, offset);
+            if (end == -1 || end + (int)sizeof(dns_rr_t) > len) {
+                return -1;
+            }
+
+            dns_rr_t* rr = (dns_rr_t*)(packet + end);
+            int rdata = end + sizeof(dns_rr_t);
+            int rdlength = ntohs(rr->rdlength);
+
+            if (rdata + rdlength > len) {
+                return -1;
+            }
+
+            dns_record_t* record = &message->records[message->nrecords++];
+            record->name = offset;
+            record->type = ntohs(rr->type);
+            record->class = ntohs(rr->class);
+            record->ttl = ntohl(rr->ttl);
+            record->rdata = rdata;
+            record->rdlength = rdlength;
+            record->section = section;
+
+            offset = rdata + rdlength;
+        }
+    }
+
+    message->end = offset;
+
+    return 0;
+}
@@ -0,0 +1,56 @@
+/**
+ * @file parse.h
+ * @brief Response Parsing Stage Header
+ *
+ * This C header file, "parse.h" defines the record index of a DNS message. The message is walked
+ * once and every resource record is described by a fixed-size descriptor holding offsets into
+ * the original packet (owner name, RDATA) and decoded header fields (type, class, TTL). Nothing is
+ * copied, so the cache, the batch mode or the daemon can inspect responses without materializing
+ * names, and formatting is a separate pass over the index.
+ *
+ * @author Oleksandr Turytsia (xturyt00)
+ * @date October 18, 2023
+ */
+#ifndef PARSE_H
+#define PARSE_H
+
+#include "dns.h"
+
+#define MAX_RECORDS 1024
+
+// Section of a resource record
+typedef enum {
+    SECTION_ANSWER,
+    SECTION_AUTHORITY,
+    SECTION_ADDITIONAL
+} section_t;
+
+// Resource record of a parsed message
+typedef struct dns_record {
+    unsigned int ttl;               // TTL
+    unsigned short name;            // Offset of the owner name
+    unsigned short type;            // Type of the record
+    unsigned short class;           // Class of the record
+    unsigned short rdata;           // Offset of the RDATA
+    unsigned short rdlength;        // Length of the RDATA
+    unsigned char section;          // Section of the record (section_t)
+} dns_record_t;
+
+// Record index of a DNS message
+typedef struct dns_message {
+    unsigned char* packet;          // Parsed packet
+    int len;                        // Length of the packet
+    int qdcount;                    // Number of questions
+    unsigned short qname;           // Offset of the QNAME of the first question
+    unsigned short qtype;           // Type of the first question
+    unsigned short qclass;          // Class of the first question
+    int counts[3];                  // Number of records in every section
+    int nrecords;                   // Number of records
+    int end;                        // Offset after the last record
+    dns_record_t records[MAX_RECORDS];
+} dns_message_t;
+
+int parse_message(dns_message_t* message, unsigned char* packet, int len);
+int skip_domain_name(unsigned char* packet, int len, int offset);
+
+#endif
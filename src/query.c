@@ -0,0 +1,342 @@
+/**
+ * @file query.c
+ * @brief DNS Query Construction
+ *
+ * This C source file, "query.c" contains functions for constructing DNS query packets. It
+ * includes encoding of domain names into the wire format and generation of reverse DNS domain
+ * names for IPv4 and IPv6 addresses.
+ *
+ * @author Oleksandr Turytsia (xturyt00)
+ * @date October 18, 2023
+ */
+#include "dns.h"
+
+/**
+ * @brief Encode a domain name into the wire format.
+ *
+ * Labels are written straight into the destination in a single pass, every label is preceded by
+ * its length and the name is terminated by the root label. A trailing dot is optional and the
+ * root name is written as `.`.
+ *
+ * @example www.google.com => 3www6google3com0
+ *
+ * @param dest Pointer to the destination buffer (at least MAX_WIRE_NAME bytes).
+ * @param name Domain name to be encoded.
+ * @param lowercase Convert letters to lowercase.
+ * @return Length of the encoded name, or -1 if a label is empty or longer than 63 bytes, or the
+ * encoded name is longer than 255 bytes.
+ */
+int encode_domain_name(unsigned char* dest, const char* name, int lowercase) {
+    int len = 0;
+
+    // Root name has no labels
+    if (name[0] == '.' && name[1] == 0) {
+        dest[0] = 0;
+        return 1;
+    }
+
+    while (*name != 0) {
+        // Position of the length byte of the current label
+        int start = len++;
+
+        while (*name != 0 && *name != '.') {
+            if (len - start > MAX_LABEL || len >= MAX_WIRE_NAME - 1) {
+                return -1;
+            }
+
+            dest[len++] = lowercase ? tolower((unsigned char)*name) : *name;
+            name++;
+        }
+
+        if (len - start == 1) {
+            return -1;
+        }
+
+        dest[start] = len - start - 1;
+
+        // Skip the dot, the trailing one ends the name
+        if (*name == '.') {
+            name++;
+        }
+    }
+
+    if (len == 0) {
+        return -1;
+    }
+
+    dest[len++] = 0;
+
+    return len;
+}
+
+/**
+ * @brief Create a DNS query packet.
+ *
+ * This function constructs a DNS query packet for the given name and type and stores
+ * it in the 'query' buffer. Only the bytes of the packet are written, so the buffer does not
+ * need to be zeroed.
+ *
+ * @param query Pointer to the buffer where the DNS query packet will be stored.
+ * @param name Domain name to be queried.
+ * @param qtype Type of the query.
+ * @param recursive Recursion Desired flag.
+ * @param lowercase Send the name in lowercase.
+ * @param id Identifier of the query in network byte order.
+ * @param edns UDP payload size advertised by an EDNS(0) OPT record (0 to send no OPT record).
+ * @param qname_size Pointer where the length of the encoded QNAME will be stored (may be NULL).
+ * @return Length of the query packet, or -1 if the name is not valid (see `encode_domain_name`).
+ */
+int create_dns_query(unsigned char* query, const char* name, unsigned short qtype, int recursive, int lowercase, unsigned short id, int edns,
+                     int* qname_size) {
+    // Initialize the DNS header
+    dns_header_t dns_header = {
+        .id = id,                   // Identificator
+        .qr = 0,                    // Query
+        .opcode = 0,                // Standard query
+        .aa = 0,                    // Authoritative 
+        .tc = 0,                    // Truncated 
+        .rd = recursive,            // Recursion Desired
+        .ra = 0,                    // Recursion Available
+        .z = 0,                     // Reserved
+        .cd = 0,
+        .ad = 0,
+        .rcode = 0,                 // Response code
+        .qdcount = htons(1),        // Number of questions, in network byte order
+        .ancount = 0,               // Number of answers
+        .nscount = 0,               // Number of authority records
+        .arcount = htons(edns ? 1 : 0) // Number of additional records (OPT)
+    };
+
+    // Copy the DNS header into the query buffer
+    memcpy(query, &dns_header, sizeof(dns_header_t));
+
+    // Encode the domain name right after the header
+    unsigned char* qname = (unsigned char*)(query + sizeof(dns_header_t));
+    int len = encode_domain_name(qname, name, lowercase);
+    if (len == -1) {
+        return -1;
+    }
+
+    if (qname_size != NULL) {
+        *qname_size = len;
+    }
+
+    // Set up the DNS question structure in the query buffer
+    dns_question_t* qinfo = (dns_question_t*)(qname + len);
+
+    // Set the query type and class
+    qinfo->qtype = htons(qtype);
+    qinfo->qclass = htons(IN);  // Internet class (IN) by default
+
+    int size = sizeof(dns_header_t) + len + sizeof(dns_question_t);
+
+    // EDNS(0) OPT pseudo-record (RFC 6891), root owner name, CLASS is the UDP payload size,
+    // TTL holds the extended RCODE, version and flags
+    if (edns) {
+        query[size++] = 0;
+
+        dns_rr_t opt = {
+            .type = htons(OPT),
+            .class = htons(edns),
+            .ttl = 0,
+            .rdlength = 0,
+        };
+
+        memcpy(query + size, &opt, sizeof(dns_rr_t));
+        size += sizeof(dns_rr_t);
+    }
+
+    return size;
+}
+
+/**
+ * @brief Get the name to be queried based on program arguments.
+ *
+ * For reverse queries the address is converted to the reverse DNS domain name (`in-addr.arpa`
+ * or `ip6.arpa`), otherwise the target is copied as is. If the target of a reverse query is not
+ * a valid IPv4 or IPv6 address, the name is empty.
+ *
+ * @param args Pointer to the program arguments structure.
+ * @param target Domain name (or address for reverse queries) to be queried.
+ * @param dest Pointer to the buffer of size MAX_NAME where the name will be stored.
+ */
+void get_query_name(args_t* args, const char* target, char* dest) {
+    if (!args->reverse) {
+        strcpy(dest, target);
+        return;
+    }
+
+    unsigned char addr[sizeof(struct in6_addr)];
+
+    // Determine whether the target address is IPv4 or IPv6 and generate the reverse address format accordingly
+    if (inet_pton(AF_INET, target, addr) == 1) {
+        reverse_dns_ipv4(dest, addr);
+    }
+    else if (inet_pton(AF_INET6, target, addr) == 1) {
+        reverse_dns_ipv6(dest, addr);
+    }
+    // Not an address, the empty name is rejected by the resolver
+    else {
+        *dest = 0;
+    }
+}
+
+/**
+ * @brief Get the type of the query based on program arguments.
+ *
+ * @param args Pointer to the program arguments structure.
+ * @return The first type of `-q` if specified, AAAA if `-6` is specified, PTR for reverse queries
+ * and A otherwise.
+ */
+unsigned short get_query_type(args_t* args) {
+    if (args->nqtypes > 0) {
+        return args->qtypes[0];
+    }
+
+    return args->ipv6 ? AAAA : args->reverse ? PTR : A;
+}
+
+/**
+ * @brief Get types of all queries of a name based on program arguments.
+ *
+ * @param args Pointer to the program arguments structure.
+ * @param qtypes Array of MAX_QTYPES types where the types will be stored.
+ * @return Number of types (types of `-q`, otherwise the single type of `get_query_type`).
+ */
+int get_query_types(args_t* args, unsigned short* qtypes) {
+    if (args->nqtypes == 0) {
+        qtypes[0] = get_query_type(args);
+        return 1;
+    }
+
+    memcpy(qtypes, args->qtypes, args->nqtypes * sizeof(unsigned short));
+    return args->nqtypes;
+}
+
+/**
+ * @brief Create a reverse DNS domain name for an IPv4 address.
+ *
+ * Octets are written from the last one as decimal labels, e.g. 1.2.3.4 => 4.3.2.1.in-addr.arpa.
+ *
+ * @param dest Pointer to the destination buffer (at least MAX_NAME bytes).
+ * @param addr IPv4 address in network byte order (4 bytes).
+ * @return Length of the reverse DNS domain name.
+ */
+int reverse_dns_ipv4(char* dest, const unsigned char* addr) {
+    int j = 0;
+
+    for (int i = 3; i >= 0; i--) {
+        unsigned int octet = addr[i];
+
+        if (octet >= 100) {
+            dest[j++] = '0' + octet / 100;
+        }
+        if (octet >= 10) {
+            dest[j++] = '0' + octet / 10 % 10;
+        }
+        dest[j++] = '0' + octet % 10;
+        dest[j++] = '.';
+    }
+
+    // Add ipv4 prefix
+    memcpy(dest + j, IPV4_REVERSE_PREFIX, sizeof(IPV4_REVERSE_PREFIX));
+
+    return j + sizeof(IPV4_REVERSE_PREFIX) - 1;
+}
+
+/**
+ * @brief Create a reverse DNS domain name for an IPv6 address.
+ *
+ * Nibbles are written from the last one as hexadecimal labels (RFC 3596 2.5),
+ * e.g. 2001:db8::1 => 1.0.0.0. ... .8.b.d.0.1.0.0.2.ip6.arpa.
+ *
+ * @param dest Pointer to the destination buffer (at least MAX_NAME bytes).
+ * @param addr IPv6 address in network byte order (16 bytes).
+ * @return Length of the reverse DNS domain name.
+ */
+int reverse_dns_ipv6(char* dest, const unsigned char* addr) {
+    static const char digits[] = "0123456789abcdef";
+    int j = 0;
+
+    for (int i = 15; i >= 0; i--) {
+        dest[j++] = digits[addr[i] & 0x0F];
+        dest[j++] = '.';
+        dest[j++] = digits[addr[i] >> 4];
+        dest[j++] = '.';
+    }
+
+    // Add ipv6 prefix
+    memcpy(dest + j, IPV6_REVERSE_PREFIX, sizeof(IPV6_REVERSE_PREFIX));
+
+    return j + sizeof(IPV6_REVERSE_PREFIX) - 1;
+}
+
+/**
+ * @brief Parse a range of addresses in the CIDR notation (e.g. 10.20.0.0/16, 2001:db8::/112).
+ *
+ * Host bits of the address are cleared, so the range starts at its network address.
+ *
+ * @param text Range in the CIDR notation.
+ * @param cidr Pointer to the range.
+ * @return 0 on success, -1 if the range is not valid or has more than 2^MAX_HOST_BITS addresses.
+ */
+int parse_cidr(const char* text, cidr_t* cidr) {
+    char addr[INET6_ADDRSTRLEN];
+
+    const char* slash = strchr(text, '/');
+    if (slash == NULL || slash - text >= (int)sizeof(addr) || slash[1] == 0) {
+        return -1;
+    }
+
+    memcpy(addr, text, slash - text);
+    addr[slash - text] = 0;
+
+    char* end;
+    long prefix = strtol(slash + 1, &end, 10);
+    if (*end != 0) {
+        return -1;
+    }
+
+    if (inet_pton(AF_INET, addr, cidr->addr) == 1) {
+        cidr->family = AF_INET;
+        cidr->len = sizeof(struct in_addr);
+    }
+    else if (inet_pton(AF_INET6, addr, cidr->addr) == 1) {
+        cidr->family = AF_INET6;
+        cidr->len = sizeof(struct in6_addr);
+    }
+    else {
+        return -1;
+    }
+
+    int bits = cidr->len * 8;
+    if (prefix < 0 || prefix > bits || bits - prefix > MAX_HOST_BITS) {
+        return -1;
+    }
+
+    cidr->prefix = prefix;
+    cidr->count = 1ULL << (bits - prefix);
+
+    // Clear host bits
+    for (int i = prefix; i < bits; i++) {
+        cidr->addr[i / 8] &= ~(0x80 >> (i % 8));
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Get an address of a range.
+ *
+ * @param cidr Pointer to the range.
+ * @param index Index of the address in the range (lower than the number of addresses).
+ * @param addr Pointer to the buffer where the address will be stored (network byte order).
+ */
+void get_cidr_address(cidr_t* cidr, unsigned long long index, unsigned char* addr) {
+    memcpy(addr, cidr->addr, cidr->len);
+
+    // Host bits are set from the last byte
+    for (int i = cidr->len - 1; index != 0; i--, index >>= 8) {
+        addr[i] |= index & 0xFF;
+    }
+}
@@ -0,0 +1,349 @@
+/**
+ * @file rdata.c
+ * @brief RDATA Decoder Registry Implementation
+ *
+ * This C source file, "rdata.c" contains decoders of RDATA of common record types and the
+ * registry which maps type codes to their mnemonics and decoders. Every decoder validates that the
+ * RDATA is consumed exactly, so malformed records fall back to the generic format.
+ *
+ * @author Oleksandr Turytsia (xturyt00)
+ * @date October 18, 2023
+ */
+#include "rdata.h"
+
+/**
+ * @brief Decode an IPv4 address (A record).
+ *
+ * Decoders of the registry have the signature of `rdata_decoder_t`, the destination is at least
+ * RDATA_TEXT(rdlength) bytes long.
+ */
+static int decode_a(char* dest, unsigned char* packet, int len, int rdata, int rdlength, const char* sep) {
+    (void)len;
+    (void)sep;
+
+    if (rdlength != sizeof(struct in_addr)) {
+        return -1;
+    }
+
+    inet_ntop(AF_INET, packet + rdata, dest, INET_ADDRSTRLEN);
+    return strlen(dest);
+}
+
+/**
+ * @brief Decode an IPv6 address (AAAA record).
+ */
+static int decode_aaaa(char* dest, unsigned char* packet, int len, int rdata, int rdlength, const char* sep) {
+    (void)len;
+    (void)sep;
+
+    if (rdlength != sizeof(struct in6_addr)) {
+        return -1;
+    }
+
+    inet_ntop(AF_INET6, packet + rdata, dest, INET6_ADDRSTRLEN);
+    return strlen(dest);
+}
+
+/**
+ * @brief Decode a domain name of RDATA.
+ *
+ * @param dest Where the name will be appended.
+ * @param packet Packet of the record.
+ * @param len Length of the packet.
+ * @param offset Offset of the name, updated to the offset after the name.
+ * @param end Offset after the RDATA.
+ * @return Length of the name, or -1 if the name is malformed or exceeds the RDATA.
+ */
+static int decode_name(char* dest, unsigned char* packet, int len, int* offset, int end) {
+    int next = parse_domain_name(packet, len, *offset, dest);
+    if (next == -1 || next > end) {
+        return -1;
+    }
+
+    *offset = next;
+    return strlen(dest);
+}
+
+/**
+ * @brief Write bytes as a quoted string.
+ *
+ * Quotes and backslashes are escaped by a backslash, non-printable bytes are written as `\DDD`.
+ *
+ * @param dest Where the string will be written.
+ * @param bytes Bytes of the string.
+ * @param length Number of bytes.
+ * @return Length of the quoted string.
+ */
+static int quote_bytes(char* dest, unsigned char* bytes, int length) {
+    int n = 0;
+
+    dest[n++] = '"';
+
+    for (int i = 0; i < length; i++) {
+        if (bytes[i] == '"' || bytes[i] == '\\') {
+            dest[n++] = '\\';
+            dest[n++] = bytes[i];
+        }
+        else if (bytes[i] < 0x20 || bytes[i] >= 0x7F) {
+            n += sprintf(dest + n, "\\%03d", bytes[i]);
+        }
+        else {
+            dest[n++] = bytes[i];
+        }
+    }
+
+    dest[n++] = '"';
+    dest[n] = 0;
+
+    return n;
+}
+
+/**
+ * @brief Decode a character-string of RDATA (RFC 1035 3.3) as a quoted string.
+ *
+ * @param dest Where the string will be written.
+ * @param packet Packet of the record.
+ * @param offset Offset of the length byte, updated to the offset after the string.
+ * @param end Offset after the RDATA.
+ * @return Length of the quoted string, or -1 if the string exceeds the RDATA.
+ */
+static int decode_string(char* dest, unsigned char* packet, int* offset, int end) {
+    if (*offset >= end || *offset + 1 + packet[*offset] > end) {
+        return -1;
+    }
+
+    int length = packet[*offset];
+    int n = quote_bytes(dest, packet + *offset + 1, length);
+
+    *offset += 1 + length;
+    return n;
+}
+
+/**
+ * @brief Decode a single domain name (NS, CNAME, PTR, MD, MF, MB, MG, MR records).
+ */
+static int decode_domain(char* dest, unsigned char* packet, int len, int rdata, int rdlength, const char* sep) {
+    (void)sep;
+
+    int offset = rdata;
+    int n = decode_name(dest, packet, len, &offset, rdata + rdlength);
+
+    return offset == rdata + rdlength ? n : -1;
+}
+
+/**
+ * @brief Decode two domain names (MINFO record).
+ */
+static int decode_minfo(char* dest, unsigned char* packet, int len, int rdata, int rdlength, const char* sep) {
+    int offset = rdata;
+    int end = rdata + rdlength;
+
+    int n = decode_name(dest, packet, len, &offset, end);
+    if (n == -1) {
+        return -1;
+    }
+
+    n += sprintf(dest + n, "%s", sep);
+
+    int m = decode_name(dest + n, packet, len, &offset, end);
+
+    return m != -1 && offset == end ? n + m : -1;
+}
+
+/**
+ * @brief Decode zone authority (SOA record).
+ */
+static int decode_soa(char* dest, unsigned char* packet, int len, int rdata, int rdlength, const char* sep) {
+    if (rdlength < (int)sizeof(dns_soa_t)) {
+        return -1;
+    }
+
+    // MNAME and RNAME are followed by five 32-bit fields
+    int n = decode_minfo(dest, packet, len, rdata, rdlength - sizeof(dns_soa_t), sep);
+    if (n == -1) {
+        return -1;
+    }
+
+    dns_soa_t* soa = (dns_soa_t*)(packet + rdata + rdlength - sizeof(dns_soa_t));
+
+    return n + sprintf(dest + n, "%s%u%s%u%s%u%s%u%s%u", sep, ntohl(soa->serial), sep, ntohl(soa->refresh), sep,
+                       ntohl(soa->retry), sep, ntohl(soa->expire), sep, ntohl(soa->min_ttl));
+}
+
+/**
+ * @brief Decode a list of character-strings (TXT and HINFO records).
+ */
+static int decode_strings(char* dest, unsigned char* packet, int len, int rdata, int rdlength, const char* sep) {
+    (void)len;
+
+    int offset = rdata;
+    int end = rdata + rdlength;
+    int n = 0;
+
+    while (offset < end) {
+        if (n > 0) {
+            n += sprintf(dest + n, "%s", sep);
+        }
+
+        int m = decode_string(dest + n, packet, &offset, end);
+        if (m == -1) {
+            return -1;
+        }
+        n += m;
+    }
+
+    // TXT has at least one string
+    return n > 0 ? n : -1;
+}
+
+/**
+ * @brief Decode a mail exchange (MX record).
+ */
+static int decode_mx(char* dest, unsigned char* packet, int len, int rdata, int rdlength, const char* sep) {
+    if (rdlength < 2) {
+        return -1;
+    }
+
+    int n = sprintf(dest, "%u%s", (packet[rdata] << 8) | packet[rdata + 1], sep);
+    int m = decode_domain(dest + n, packet, len, rdata + 2, rdlength - 2, sep);
+
+    return m != -1 ? n + m : -1;
+}
+
+/**
+ * @brief Decode a service location (SRV record, RFC 2782).
+ */
+static int decode_srv(char* dest, unsigned char* packet, int len, int rdata, int rdlength, const char* sep) {
+    if (rdlength < 6) {
+        return -1;
+    }
+
+    unsigned char* fields = packet + rdata;
+
+    int n = sprintf(dest, "%u%s%u%s%u%s", (fields[0] << 8) | fields[1], sep, (fields[2] << 8) | fields[3], sep,
+                    (fields[4] << 8) | fields[5], sep);
+    int m = decode_domain(dest + n, packet, len, rdata + 6, rdlength - 6, sep);
+
+    return m != -1 ? n + m : -1;
+}
+
+/**
+ * @brief Decode a certification authority authorization (CAA record, RFC 8659).
+ *
+ * The tag is written as is, the value as a quoted string.
+ */
+static int decode_caa(char* dest, unsigned char* packet, int len, int rdata, int rdlength, const char* sep) {
+    (void)len;
+
+    unsigned char* fields = packet + rdata;
+
+    // Flags, length of the tag and the tag of at least one byte
+    if (rdlength < 3 || fields[1] == 0 || 2 + fields[1] > rdlength) {
+        return -1;
+    }
+
+    int n = sprintf(dest, "%u%s", fields[0], sep);
+
+    for (int i = 0; i < fields[1]; i++) {
+        if (!isalnum(fields[2 + i])) {
+            return -1;
+        }
+        dest[n++] = fields[2 + i];
+    }
+
+    n += sprintf(dest + n, "%s", sep);
+
+    // Value takes the rest of the RDATA, it has no length byte
+    return n + quote_bytes(dest + n, fields + 2 + fields[1], rdlength - 2 - fields[1]);
+}
+
+// Registry of record types indexed by the type code (types without a name are unknown)
+static const rdata_type_t rdata_types[RDATA_TYPES] = {
+    [A] = { "A", decode_a },
+    [NS] = { "NS", decode_domain },
+    [MD] = { "MD", decode_domain },
+    [MF] = { "MF", decode_domain },
+    [CNAME] = { "CNAME", decode_domain },
+    [SOA] = { "SOA", decode_soa },
+    [MB] = { "MB", decode_domain },
+    [MG] = { "MG", decode_domain },
+    [MR] = { "MR", decode_domain },
+    [NIL] = { "NULL", NULL },
+    [WKS] = { "WKS", NULL },
+    [PTR] = { "PTR", decode_domain },
+    [HINFO] = { "HINFO", decode_strings },
+    [MINFO] = { "MINFO", decode_minfo },
+    [MX] = { "MX", decode_mx },
+    [TXT] = { "TXT", decode_strings },
+    [AAAA] = { "AAAA", decode_aaaa },
+    [SRV] = { "SRV", decode_srv },
+    [OPT] = { "OPT", NULL },
+    [CAA] = { "CAA", decode_caa },
+};
+
+/**
+ * @brief Look up a record type in the registry.
+ *
+ * @param type Type code.
+ * @return Record type, or NULL if the type is unknown.
+ */
+const rdata_type_t* get_rdata_type(unsigned short type) {
+    if (type >= RDATA_TYPES || rdata_types[type].name == NULL) {
+        return NULL;
+    }
+
+    return &rdata_types[type];
+}
+
+/**
+ * @brief Format RDATA of a record in presentation format.
+ *
+ * RDATA is decoded by the decoder of its type, RDATA of unknown types and malformed RDATA is
+ * written in the generic format of RFC 3597 (`\# length hex`). The text is written into the
+ * provided buffer if it is large enough, otherwise into an allocated buffer.
+ *
+ * @param small Buffer for the text.
+ * @param size Size of the buffer.
+ * @param packet Packet of the record.
+ * @param len Length of the packet.
+ * @param type Type of the record.
+ * @param rdata Offset of the RDATA.
+ * @param rdlength Length of the RDATA.
+ * @param sep Separator of fields.
+ * @return Text of the RDATA, it has to be freed if it is not `small`.
+ */
+char* format_rdata(char* small, int size, unsigned char* packet, int len, unsigned short type, int rdata, int rdlength, const char* sep) {
+    static const char hex[] = "0123456789abcdef";
+
+    char* text = small;
+
+    if (RDATA_TEXT(rdlength) > size) {
+        text = malloc(RDATA_TEXT(rdlength));
+        if (text == NULL) {
+            exit_error(E_EAI, strerror(errno));
+        }
+    }
+
+    const rdata_type_t* rdata_type = get_rdata_type(type);
+
+    if (rdata_type != NULL && rdata_type->decode != NULL && rdata + rdlength <= len &&
+        rdata_type->decode(text, packet, len, rdata, rdlength, sep) != -1) {
+        return text;
+    }
+
+    // Unknown or malformed RDATA
+    int n = sprintf(text, "\\# %d", rdlength);
+
+    if (rdlength != 0) {
+        text[n++] = ' ';
+    }
+
+    for (int i = 0; i < rdlength && rdata + i < len; i++) {
+        text[n++] = hex[packet[rdata + i] >> 4];
+        text[n++] = hex[packet[rdata + i] & 0x0F];
+    }
+
+    text[n] = 0;
+
+    return text;
+}
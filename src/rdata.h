@@ -0,0 +1,39 @@
+/**
+ * @file rdata.h
+ * @brief RDATA Decoder Registry Header
+ *
+ * This C header file, "rdata.h" declares the registry of record types. The registry is a table
+ * indexed directly by the type code, every known type has its mnemonic and the decoder of its
+ * RDATA into presentation format. RDATA of unknown types and malformed RDATA of known types is
+ * formatted in the generic format of RFC 3597 (`\# length hex`).
+ *
+ * Decoders are shared by the text output (fields separated by ", ") and by the JSON Lines output
+ * (fields separated by a space as in zone files).
+ *
+ * @author Oleksandr Turytsia (xturyt00)
+ * @date October 18, 2023
+ */
+#ifndef RDATA_H
+#define RDATA_H
+
+#include "dns.h"
+
+#define RDATA_TYPES (CAA + 1)
+#define RDATA_SMALL 2048
+
+// Size of the presentation format of RDATA of the given length (including the terminating zero)
+#define RDATA_TEXT(rdlength) (4 * (rdlength) + 2 * MAX_NAME + 128)
+
+// Decoder of RDATA into presentation format, returns the length of the text or -1 if malformed
+typedef int (*rdata_decoder_t)(char* dest, unsigned char* packet, int len, int rdata, int rdlength, const char* sep);
+
+// Record type of the registry
+typedef struct {
+    const char* name;               // Mnemonic of the type
+    rdata_decoder_t decode;         // Decoder of the RDATA (NULL for the generic format)
+} rdata_type_t;
+
+const rdata_type_t* get_rdata_type(unsigned short type);
+char* format_rdata(char* small, int size, unsigned char* packet, int len, unsigned short type, int rdata, int rdlength, const char* sep);
+
+#endif
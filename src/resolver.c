@@ -0,0 +1,1278 @@
+/**
+ * @file resolver.c
+ * @brief Asynchronous Resolver Engine Implementation
+ *
+ * This C source file, "resolver.c" contains the implementation of the asynchronous resolver
+ * engine. Queries are sent over non-blocking UDP sockets (one per server) and the engine waits
+ * for responses with epoll. Up to `window` queries are outstanding at the same time, other
+ * queries wait in a FIFO queue.
+ *
+ * Every outstanding query has its own identifier, which is used as an index into a table of
+ * outstanding queries. A response is accepted only if its identifier is known, it came from
+ * the server the query was sent to and the question section matches the one that was sent.
+ * Timeouts are tracked by a binary heap ordered by deadlines of outstanding queries.
+ *
+ * A query that times out is retransmitted (with the same identifier) until the configured number
+ * of retries is exhausted, the timeout doubles with every retransmission. The server of every
+ * transmission is chosen by its smoothed RTT (RFC 6298 style, measured only on queries that were
+ * not retransmitted), servers that were already tried by the query are avoided. A timeout raises
+ * the RTT of the server to the timeout, RTTs of servers that are not selected slowly decay, so
+ * a penalized server is probed again later.
+ *
+ * A truncated response switches the query to TCP and the query is sent again to the same server.
+ * TCP connections are opened on demand and kept open, queries are written back to back with
+ * length prefixes (RFC 1035 4.2.2) and responses are matched by their identifiers in any order.
+ * If a connection is closed, queries waiting for a response on it are retransmitted immediately.
+ *
+ * UDP queries are queued per server and sent by a single `sendmmsg` call before the event loop
+ * waits, responses are drained by `recvmmsg`, so bulk resolution needs a few syscalls per batch
+ * of queries instead of a few per query.
+ *
+ * @author Oleksandr Turytsia (xturyt00)
+ * @date October 18, 2023
+ */
+#include "resolver.h"
+
+/**
+ * @brief Get the current time in milliseconds (CLOCK_MONOTONIC).
+ *
+ * @return Current time in milliseconds.
+ */
+long long resolver_now(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (long long)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+/**
+ * @brief Get the current time in microseconds (CLOCK_MONOTONIC).
+ *
+ * @return Current time in microseconds.
+ */
+static long long now_us(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (long long)now.tv_sec * 1000000 + now.tv_nsec / 1000;
+}
+
+/**
+ * @brief Swap two queries in the timer heap.
+ */
+static void heap_swap(resolver_t* resolver, int a, int b) {
+    resolver_query_t* tmp = resolver->heap[a];
+    resolver->heap[a] = resolver->heap[b];
+    resolver->heap[b] = tmp;
+
+    resolver->heap[a]->heap_index = a;
+    resolver->heap[b]->heap_index = b;
+}
+
+/**
+ * @brief Restore the heap property from the given position towards the root and the leaves.
+ */
+static void heap_fix(resolver_t* resolver, int i) {
+    // Sift up
+    while (i > 0 && resolver->heap[(i - 1) / 2]->deadline > resolver->heap[i]->deadline) {
+        heap_swap(resolver, i, (i - 1) / 2);
+        i = (i - 1) / 2;
+    }
+
+    // Sift down
+    while (1) {
+        int min = i;
+        int left = 2 * i + 1;
+        int right = 2 * i + 2;
+
+        if (left < resolver->nheap && resolver->heap[left]->deadline < resolver->heap[min]->deadline) {
+            min = left;
+        }
+        if (right < resolver->nheap && resolver->heap[right]->deadline < resolver->heap[min]->deadline) {
+            min = right;
+        }
+        if (min == i) {
+            break;
+        }
+
+        heap_swap(resolver, i, min);
+        i = min;
+    }
+}
+
+/**
+ * @brief Insert a query into the timer heap.
+ */
+static void heap_push(resolver_t* resolver, resolver_query_t* query) {
+    query->heap_index = resolver->nheap;
+    resolver->heap[resolver->nheap++] = query;
+    heap_fix(resolver, query->heap_index);
+}
+
+/**
+ * @brief Remove a query from the timer heap.
+ */
+static void heap_remove(resolver_t* resolver, resolver_query_t* query) {
+    int i = query->heap_index;
+
+    if (i < 0) {
+        return;
+    }
+
+    query->heap_index = -1;
+    resolver->nheap--;
+
+    if (i != resolver->nheap) {
+        resolver->heap[i] = resolver->heap[resolver->nheap];
+        resolver->heap[i]->heap_index = i;
+        heap_fix(resolver, i);
+    }
+}
+
+/**
+ * @brief Compare question sections of a query and a response.
+ *
+ * Domain names are compared case-insensitively, as servers are not required to preserve the case.
+ *
+ * @param query Query packet.
+ * @param response Response packet.
+ * @param qlen Length of the query (header + question).
+ * @param len Length of the response.
+ * @return 1 if the questions match, 0 otherwise.
+ */
+static int is_question_echoed(unsigned char* query, unsigned char* response, int qlen, int len) {
+    if (len < qlen || ((dns_header_t*)response)->qdcount != htons(1)) {
+        return 0;
+    }
+
+    for (int i = sizeof(dns_header_t); i < qlen; i++) {
+        if (tolower(query[i]) != tolower(response[i])) {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+/**
+ * @brief Finish an outstanding query, call its callback and release its slot.
+ *
+ * The slot stays reserved while the callback runs, so the callback may submit new queries.
+ *
+ * @param resolver Pointer to the resolver.
+ * @param query Finished query.
+ * @param err Error code of the query (0 on success).
+ * @param packet Response packet (NULL on error).
+ * @param len Length of the response packet.
+ */
+static void finish_query(resolver_t* resolver, resolver_query_t* query, int err, unsigned char* packet, int len) {
+    heap_remove(resolver, query);
+
+    resolver_result_t result = {
+        .err = err,
+        .name = query->name,
+        .qtype = query->qtype,
+        .packet = err ? NULL : packet,
+        .len = err ? 0 : len,
+        .qname_size = query->qname_size,
+        .server = query->server,
+    };
+
+    query->callback(resolver, &result, query->data);
+
+    int slot = resolver->id_map[query->id];
+
+    query->active = 0;
+    resolver->id_map[query->id] = -1;
+    resolver->free_slots[resolver->nfree++] = slot;
+}
+
+/**
+ * @brief Select the server for the next transmission of a query.
+ *
+ * Servers that were not tried by the query are preferred, among them the server with the lowest
+ * smoothed RTT is selected (unused servers first). Ties are broken in round robin.
+ *
+ * @param resolver Pointer to the resolver.
+ * @param tried Servers already tried by the query.
+ * @return Index of the selected server.
+ */
+static int select_server(resolver_t* resolver, unsigned int tried) {
+    int n = resolver->nservers;
+
+    // All servers were tried, any of them can be used again
+    if ((tried & ((1u << n) - 1)) == ((1u << n) - 1)) {
+        tried = 0;
+    }
+
+    int best = -1;
+    for (int k = 0; k < n; k++) {
+        int i = (resolver->next_server + k) % n;
+
+        if (!(tried & (1u << i)) && (best == -1 || resolver->servers[i].srtt < resolver->servers[best].srtt)) {
+            best = i;
+        }
+    }
+
+    // Decay RTTs of other servers, so they are probed again eventually
+    for (int i = 0; i < n; i++) {
+        if (i != best) {
+            resolver->servers[i].srtt -= resolver->servers[i].srtt >> 8;
+        }
+    }
+
+    resolver->next_server = (best + 1) % n;
+
+    return best;
+}
+
+/**
+ * @brief Close the TCP connection to a server.
+ *
+ * Queries waiting for a response on the connection expire immediately. Buffers of the
+ * connection are kept for the next connection.
+ *
+ * @param resolver Pointer to the resolver.
+ * @param server Server of the connection.
+ */
+static void close_tcp(resolver_t* resolver, resolver_server_t* server) {
+    resolver_tcp_t* tcp = &server->tcp;
+
+    if (tcp->watch.fd == -1) {
+        return;
+    }
+
+    resolver_unwatch(resolver, &tcp->watch);
+    close(tcp->watch.fd);
+
+    tcp->watch.fd = -1;
+    tcp->connecting = 0;
+    tcp->writing = 0;
+    tcp->inlen = 0;
+    tcp->outlen = 0;
+    tcp->generation++;
+
+    int index = server - resolver->servers;
+    long long now = resolver_now();
+
+    for (int i = 0; i < resolver->nheap; i++) {
+        resolver_query_t* query = resolver->heap[i];
+
+        if (query->tcp && query->server == index) {
+            query->deadline = now;
+            heap_fix(resolver, query->heap_index);
+        }
+    }
+}
+
+/**
+ * @brief Write buffered queries to the TCP connection of a server.
+ *
+ * @param resolver Pointer to the resolver.
+ * @param tcp TCP connection.
+ * @return 0 on success, -1 if the connection failed.
+ */
+static int flush_tcp(resolver_t* resolver, resolver_tcp_t* tcp) {
+    int written = 0;
+
+    while (!tcp->connecting && written < tcp->outlen) {
+        ssize_t n = send(tcp->watch.fd, tcp->out + written, tcp->outlen - written, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                break;
+            }
+            return -1;
+        }
+        written += n;
+    }
+
+    memmove(tcp->out, tcp->out + written, tcp->outlen - written);
+    tcp->outlen -= written;
+
+    // Wait until the socket is writable only if something is left (or it is connecting)
+    int writing = tcp->connecting || tcp->outlen > 0;
+    if (writing == tcp->writing) {
+        return 0;
+    }
+
+    tcp->writing = writing;
+    return resolver_watch(resolver, &tcp->watch, writing ? EPOLLIN | EPOLLOUT : EPOLLIN);
+}
+
+static void read_tcp(resolver_t* resolver, resolver_watch_t* watch, unsigned int events);
+
+/**
+ * @brief Open the TCP connection to a server (non-blocking).
+ *
+ * @param resolver Pointer to the resolver.
+ * @param server Server of the connection.
+ * @return 0 on success, -1 on failure.
+ */
+static int open_tcp(resolver_t* resolver, resolver_server_t* server) {
+    resolver_tcp_t* tcp = &server->tcp;
+
+    if (tcp->in == NULL && (tcp->in = malloc(MAX_BUFF + 2)) == NULL) {
+        return -1;
+    }
+
+    int sockt = socket(server->addr.family, SOCK_STREAM | SOCK_NONBLOCK, IPPROTO_TCP);
+    if (sockt == -1) {
+        return -1;
+    }
+
+    if (connect(sockt, (struct sockaddr*)&server->addr.addr, server->addr.addr_len) == -1 && errno != EINPROGRESS) {
+        close(sockt);
+        return -1;
+    }
+
+    tcp->watch.fd = sockt;
+    tcp->watch.handler = read_tcp;
+    tcp->watch.data = server;
+    tcp->connecting = 1;
+    tcp->writing = 1;
+
+    if (resolver_watch(resolver, &tcp->watch, EPOLLIN | EPOLLOUT)) {
+        close(sockt);
+        tcp->watch.fd = -1;
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Send a query over the TCP connection to a server.
+ *
+ * The connection is opened if needed, the query is written after queries that were sent before.
+ *
+ * @param resolver Pointer to the resolver.
+ * @param server Server of the connection.
+ * @param query Query to be sent.
+ * @return 0 on success, -1 on failure.
+ */
+static int send_tcp(resolver_t* resolver, resolver_server_t* server, resolver_query_t* query) {
+    resolver_tcp_t* tcp = &server->tcp;
+
+    if (tcp->watch.fd == -1 && open_tcp(resolver, server)) {
+        return -1;
+    }
+
+    if (tcp->outlen + query->qlen + 2 > tcp->outcap) {
+        int cap = tcp->outcap ? tcp->outcap * 2 : MAX_QUERY * 16;
+        while (cap < tcp->outlen + query->qlen + 2) {
+            cap *= 2;
+        }
+
+        unsigned char* out = realloc(tcp->out, cap);
+        if (out == NULL) {
+            return -1;
+        }
+
+        tcp->out = out;
+        tcp->outcap = cap;
+    }
+
+    tcp->out[tcp->outlen++] = query->qlen >> 8;
+    tcp->out[tcp->outlen++] = query->qlen & 0xFF;
+    memcpy(tcp->out + tcp->outlen, query->query, query->qlen);
+    tcp->outlen += query->qlen;
+
+    return flush_tcp(resolver, tcp);
+}
+
+/**
+ * @brief Expire a query that could not be sent, so it is retransmitted or finished with `E_SENDTO`.
+ *
+ * @param resolver Pointer to the resolver.
+ * @param query Query that could not be sent.
+ */
+static void fail_query(resolver_t* resolver, resolver_query_t* query) {
+    query->err = E_SENDTO;
+    query->deadline = resolver_now();
+    heap_fix(resolver, query->heap_index);
+}
+
+/**
+ * @brief Start the multishot receive of a server socket (io_uring transport).
+ *
+ * @param resolver Pointer to the resolver.
+ * @param index Index of the server.
+ * @return 0 on success, -1 on failure.
+ */
+static int arm_recv(resolver_t* resolver, int index) {
+    struct io_uring_sqe* sqe = uring_get_sqe(&resolver->uring);
+    if (sqe == NULL) {
+        return -1;
+    }
+
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = resolver->servers[index].watch.fd;
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = 0;
+    sqe->user_data = REQUEST_RECV << 56 | (unsigned long long)index;
+
+    return uring_submit(&resolver->uring) < 0 ? -1 : 0;
+}
+
+/**
+ * @brief Send UDP queries waiting for a server by io_uring.
+ *
+ * Queries are written directly from the registered buffer of query slots, all of them by
+ * a single `io_uring_enter` call. Failed writes are reported by their completions, queries of
+ * a failed submission are withdrawn from the ring and failed at once.
+ *
+ * @param resolver Pointer to the resolver.
+ * @param server Server of the queries.
+ */
+static void submit_udp(resolver_t* resolver, resolver_server_t* server) {
+    resolver_query_t* prepared[MAX_BATCH];
+    int nprepared = 0;
+
+    for (int i = 0; i < server->nsendq; i++) {
+        resolver_query_t* query = server->sendq[i];
+
+        struct io_uring_sqe* sqe = uring_get_sqe(&resolver->uring);
+        if (sqe == NULL) {
+            fail_query(resolver, query);
+            continue;
+        }
+
+        sqe->opcode = IORING_OP_WRITE_FIXED;
+        sqe->fd = server->watch.fd;
+        sqe->addr = (unsigned long)query->query;
+        sqe->len = query->qlen;
+        sqe->off = (unsigned long long)-1;
+        sqe->buf_index = 0;
+        sqe->user_data = REQUEST_SEND << 56 | (unsigned long long)query->id << 32 | (query - resolver->slots);
+        prepared[nprepared++] = query;
+    }
+
+    server->nsendq = 0;
+
+    // Entries submitted while the ring was full are reported by their completions
+    if (uring_submit(&resolver->uring) < 0) {
+        int withdrawn = uring_withdraw(&resolver->uring, nprepared);
+
+        for (int i = nprepared - withdrawn; i < nprepared; i++) {
+            fail_query(resolver, prepared[i]);
+        }
+    }
+}
+
+/**
+ * @brief Send UDP queries waiting for a server by `sendmmsg` (or by io_uring if it is used).
+ *
+ * @param resolver Pointer to the resolver.
+ * @param server Server of the queries.
+ */
+static void flush_udp(resolver_t* resolver, resolver_server_t* server) {
+    if (resolver->uring.fd != -1) {
+        submit_udp(resolver, server);
+        return;
+    }
+
+    struct mmsghdr msgs[MAX_BATCH];
+    struct iovec iov[MAX_BATCH];
+
+    memset(msgs, 0, server->nsendq * sizeof(struct mmsghdr));
+
+    for (int i = 0; i < server->nsendq; i++) {
+        iov[i].iov_base = server->sendq[i]->query;
+        iov[i].iov_len = server->sendq[i]->qlen;
+        msgs[i].msg_hdr.msg_iov = &iov[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+
+    int sent = 0;
+    while (sent < server->nsendq) {
+        int n = sendmmsg(server->watch.fd, msgs + sent, server->nsendq - sent, 0);
+
+        // The first remaining query failed, others are tried again
+        if (n <= 0) {
+            fail_query(resolver, server->sendq[sent]);
+            n = 1;
+        }
+
+        sent += n;
+    }
+
+    server->nsendq = 0;
+}
+
+/**
+ * @brief Send UDP queries waiting for all servers.
+ *
+ * @param resolver Pointer to the resolver.
+ */
+static void flush_sends(resolver_t* resolver) {
+    for (int i = 0; i < resolver->nservers; i++) {
+        if (resolver->servers[i].nsendq > 0) {
+            flush_udp(resolver, &resolver->servers[i]);
+        }
+    }
+}
+
+/**
+ * @brief Send a query to a server and (re)arm its timer.
+ *
+ * UDP queries are only queued, they are sent by `flush_sends` before the event loop waits
+ * (or once MAX_BATCH queries are queued for the server). If the query cannot be sent, its timer
+ * expires immediately, so it is retransmitted to another server or finished with `E_SENDTO`.
+ *
+ * @param resolver Pointer to the resolver.
+ * @param query Query to be sent.
+ * @param index Index of the server.
+ */
+static void transmit_query(resolver_t* resolver, resolver_query_t* query, int index) {
+    resolver_server_t* server = &resolver->servers[index];
+
+    query->server = index;
+    query->tried |= 1u << index;
+    query->sent = now_us();
+    query->deadline = resolver_now() + ((long long)resolver->config.timeout << query->attempt);
+    query->err = 0;
+
+    if (query->heap_index < 0) {
+        heap_push(resolver, query);
+    }
+    else {
+        heap_fix(resolver, query->heap_index);
+    }
+
+    if (resolver->config.capture != NULL) {
+        capture_packet(resolver->config.capture, (struct sockaddr*)&server->local, (struct sockaddr*)&server->addr.addr,
+                       query->query, query->qlen);
+    }
+
+    if (query->tcp) {
+        if (send_tcp(resolver, server, query)) {
+            close_tcp(resolver, server);
+            fail_query(resolver, query);
+        }
+        return;
+    }
+
+    // UDP queries are sent in batches
+    server->sendq[server->nsendq++] = query;
+    if (server->nsendq == MAX_BATCH) {
+        flush_udp(resolver, server);
+    }
+}
+
+/**
+ * @brief Send a query to the selected server and (re)arm its timer.
+ *
+ * @param resolver Pointer to the resolver.
+ * @param query Query to be sent.
+ */
+static void send_query(resolver_t* resolver, resolver_query_t* query) {
+    int index = select_server(resolver, query->tried);
+
+    // RTT of a server is pessimistic until its first response, so it is not flooded while probed
+    resolver_server_t* server = &resolver->servers[index];
+    if (server->samples == 0 && server->srtt == 0) {
+        server->srtt = (long long)resolver->config.timeout * 1000;
+    }
+
+    transmit_query(resolver, query, index);
+}
+
+/**
+ * @brief Handle an expired timer of a query.
+ *
+ * The server is penalized and the query is retransmitted, or finished with `E_TIMEOUT` if
+ * there are no retries left.
+ *
+ * @param resolver Pointer to the resolver.
+ * @param query Query that timed out.
+ */
+static void expire_query(resolver_t* resolver, resolver_query_t* query) {
+    resolver_server_t* server = &resolver->servers[query->server];
+    long long timeout = ((long long)resolver->config.timeout << query->attempt) * 1000;
+
+    if (server->srtt < timeout) {
+        server->srtt = timeout;
+    }
+
+    if (query->attempt >= resolver->config.retries) {
+        finish_query(resolver, query, query->err ? query->err : E_TIMEOUT, NULL, 0);
+        return;
+    }
+
+    query->attempt++;
+    send_query(resolver, query);
+}
+
+/**
+ * @brief Draw a random query identifier.
+ *
+ * Identifiers are taken from a pool filled by `getrandom`, so the system call is made once per
+ * RANDOM_IDS queries. If the random source fails, the program is terminated rather than sending
+ * predictable identifiers.
+ *
+ * @param resolver Pointer to the resolver.
+ * @return Random identifier.
+ */
+static unsigned short random_id(resolver_t* resolver) {
+    if (resolver->nids == 0) {
+        size_t filled = 0;
+
+        while (filled < sizeof(resolver->ids)) {
+            ssize_t n = getrandom((char*)resolver->ids + filled, sizeof(resolver->ids) - filled, 0);
+            if (n == -1 && errno != EINTR) {
+                exit_error(E_EAI, strerror(errno));
+            }
+            filled += n > 0 ? n : 0;
+        }
+
+        resolver->nids = RANDOM_IDS;
+    }
+
+    return resolver->ids[--resolver->nids];
+}
+
+/**
+ * @brief Start a query in a free slot.
+ *
+ * @param resolver Pointer to the resolver.
+ * @param name Name to be queried.
+ * @param qtype Type of the query.
+ * @param callback Completion callback.
+ * @param data User data for the callback.
+ */
+static void start_query(resolver_t* resolver, const char* name, unsigned short qtype, resolver_callback_t callback, void* data) {
+    int slot = resolver->free_slots[--resolver->nfree];
+
+    // Identifiers are unpredictable, so off-path attackers cannot spoof responses
+    unsigned short id;
+    do {
+        id = random_id(resolver);
+    } while (resolver->id_map[id] != -1);
+
+    resolver_query_t* query = &resolver->slots[slot];
+
+    query->active = 1;
+    query->server = -1;
+    query->tried = 0;
+    query->attempt = 0;
+    query->tcp = resolver->config.tcp;
+    query->err = 0;
+    query->id = id;
+    query->qtype = qtype;
+    query->callback = callback;
+    query->data = data;
+    query->heap_index = -1;
+    strncpy(query->name, name, MAX_NAME - 1);
+    query->name[MAX_NAME - 1] = 0;
+
+    resolver->id_map[id] = slot;
+
+    if (strlen(name) == 0 || strlen(name) >= MAX_NAME - 1) {
+        finish_query(resolver, query, E_QNAME, NULL, 0);
+        return;
+    }
+
+    query->qlen = create_dns_query(query->query, query->name, qtype, resolver->config.recursive, resolver->config.lowercase, htons(id),
+                                   resolver->config.edns, &query->qname_size);
+    if (query->qlen == -1) {
+        finish_query(resolver, query, E_QNAME, NULL, 0);
+        return;
+    }
+
+    // Answer from the cache
+    if (resolver->config.cache != NULL) {
+        int len = cache_lookup(resolver->config.cache, query->name, qtype, IN, resolver->buffer);
+        if (len >= 0) {
+            ((dns_header_t*)resolver->buffer)->id = htons(id);
+            ((dns_header_t*)resolver->buffer)->rd = resolver->config.recursive;
+            query->server = -1;
+            finish_query(resolver, query, 0, resolver->buffer, len);
+            return;
+        }
+    }
+
+    send_query(resolver, query);
+}
+
+/**
+ * @brief Move queued queries into free slots.
+ *
+ * @param resolver Pointer to the resolver.
+ */
+static void start_queued(resolver_t* resolver) {
+    while (resolver->nfree > 0 && resolver->queue_head != NULL) {
+        resolver_queued_t* queued = resolver->queue_head;
+
+        resolver->queue_head = queued->next;
+        if (resolver->queue_head == NULL) {
+            resolver->queue_tail = NULL;
+        }
+        resolver->nqueued--;
+
+        start_query(resolver, queued->name, queued->qtype, queued->callback, queued->data);
+        free(queued);
+    }
+}
+
+/**
+ * @brief Match a response to its outstanding query.
+ *
+ * @param resolver Pointer to the resolver.
+ * @param server Index of the server that sent the response.
+ * @param packet Response packet.
+ * @param len Length of the response.
+ * @param tcp Response was received over TCP.
+ */
+static void handle_response(resolver_t* resolver, int server, unsigned char* packet, int len, int tcp) {
+    // Every received message is recorded, also the ones that are dropped
+    if (resolver->config.capture != NULL) {
+        resolver_server_t* s = &resolver->servers[server];
+        capture_packet(resolver->config.capture, (struct sockaddr*)&s->addr.addr, (struct sockaddr*)&s->local, packet, len);
+    }
+
+    if (len < (int)sizeof(dns_header_t)) {
+        return;
+    }
+
+    dns_header_t* header = (dns_header_t*)packet;
+    int slot = resolver->id_map[ntohs(header->id)];
+
+    if (slot == -1) {
+        return;
+    }
+
+    resolver_query_t* query = &resolver->slots[slot];
+
+    // A response from a server the query was not sent to or to a different question (late or spoofed response),
+    // a late response to an earlier transmission is accepted
+    if (!(query->tried & (1u << server)) || query->heap_index < 0 || query->tcp != tcp ||
+        !is_question_echoed(query->query, packet, sizeof(dns_header_t) + query->qname_size + sizeof(dns_question_t), len)) {
+        return;
+    }
+
+    // RTT of a retransmitted query is ambiguous (Karn's algorithm), TCP includes the handshake
+    if (query->attempt == 0 && !tcp) {
+        resolver_server_t* s = &resolver->servers[server];
+        long long rtt = now_us() - query->sent + 1;
+
+        s->srtt = s->samples++ == 0 ? rtt : s->srtt + (rtt - s->srtt) / 8;
+    }
+
+    // Truncated response, ask the same server over TCP
+    if (header->tc && !tcp) {
+        query->tcp = 1;
+        transmit_query(resolver, query, server);
+        return;
+    }
+
+    query->server = server;
+
+    if (resolver->config.cache != NULL) {
+        cache_store(resolver->config.cache, query->name, query->qtype, IN, packet, len);
+    }
+
+    finish_query(resolver, query, 0, packet, len);
+}
+
+/**
+ * @brief Read all available responses from a server socket.
+ *
+ * Handler of server UDP sockets, that matches responses to outstanding queries. Responses are
+ * received in batches of up to MAX_BATCH datagrams by a single `recvmmsg` call, directly into
+ * the receive ring. A datagram that does not fit into its slot is handled as a truncated response.
+ *
+ * @param resolver Pointer to the resolver.
+ * @param watch Watch of the server socket.
+ * @param events Ready events.
+ */
+static void read_responses(resolver_t* resolver, resolver_watch_t* watch, unsigned int events) {
+    (void)events;
+
+    int server = (resolver_server_t*)watch->data - resolver->servers;
+
+    while (1) {
+        int n = recvmmsg(watch->fd, resolver->recv_msgs, MAX_BATCH, 0, NULL);
+        if (n <= 0) {
+            // Nothing more to read, or an ICMP error that is handled by the timer
+            break;
+        }
+
+        for (int i = 0; i < n; i++) {
+            unsigned char* packet = resolver->recv_ring + i * resolver->recv_size;
+            int len = resolver->recv_msgs[i].msg_len;
+
+            if ((resolver->recv_msgs[i].msg_hdr.msg_flags & MSG_TRUNC) && len >= (int)sizeof(dns_header_t)) {
+                ((dns_header_t*)packet)->tc = 1;
+            }
+
+            handle_response(resolver, server, packet, len, 0);
+        }
+
+        if (n < MAX_BATCH) {
+            break;
+        }
+    }
+}
+
+/**
+ * @brief Handle events of the TCP connection to a server.
+ *
+ * Handler of server TCP sockets, that finishes connecting, writes buffered queries and matches
+ * received responses to outstanding queries.
+ *
+ * @param resolver Pointer to the resolver.
+ * @param watch Watch of the connection socket.
+ * @param events Ready events.
+ */
+static void read_tcp(resolver_t* resolver, resolver_watch_t* watch, unsigned int events) {
+    resolver_server_t* server = watch->data;
+    resolver_tcp_t* tcp = &server->tcp;
+    int index = server - resolver->servers;
+
+    if (tcp->connecting) {
+        int err = 0;
+        socklen_t err_len = sizeof(err);
+
+        if (getsockopt(watch->fd, SOL_SOCKET, SO_ERROR, &err, &err_len) || err) {
+            close_tcp(resolver, server);
+            return;
+        }
+
+        if (!(events & EPOLLOUT)) {
+            return;
+        }
+
+        tcp->connecting = 0;
+    }
+
+    if ((events & EPOLLOUT) && flush_tcp(resolver, tcp)) {
+        close_tcp(resolver, server);
+        return;
+    }
+
+    if (!(events & (EPOLLIN | EPOLLHUP | EPOLLERR))) {
+        return;
+    }
+
+    int generation = tcp->generation;
+
+    while (1) {
+        ssize_t n = recv(watch->fd, tcp->in + tcp->inlen, MAX_BUFF + 2 - tcp->inlen, 0);
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return;
+        }
+
+        if (n <= 0) {
+            close_tcp(resolver, server);
+            return;
+        }
+
+        tcp->inlen += n;
+
+        // Handle all complete responses
+        int offset = 0;
+        while (tcp->inlen - offset >= 2) {
+            int len = (tcp->in[offset] << 8) | tcp->in[offset + 1];
+            if (tcp->inlen - offset - 2 < len) {
+                break;
+            }
+
+            unsigned char* packet = tcp->in + offset + 2;
+            offset += len + 2;
+
+            handle_response(resolver, index, packet, len, 1);
+
+            // Connection was closed by a callback
+            if (tcp->generation != generation) {
+                return;
+            }
+        }
+
+        memmove(tcp->in, tcp->in + offset, tcp->inlen - offset);
+        tcp->inlen -= offset;
+    }
+}
+
+/**
+ * @brief Handle completions of io_uring requests.
+ *
+ * Handler of the ring, that matches received responses to outstanding queries and gives their
+ * buffers back to the kernel. A response that fills the whole buffer does not fit into the
+ * advertised payload size, so it is handled as a truncated response.
+ *
+ * @param resolver Pointer to the resolver.
+ * @param watch Watch of the ring.
+ * @param events Ready events.
+ */
+static void reap_completions(resolver_t* resolver, resolver_watch_t* watch, unsigned int events) {
+    (void)watch;
+    (void)events;
+
+    int stride = resolver->recv_size + 1;
+    struct io_uring_cqe* cqe;
+
+    while ((cqe = uring_peek_cqe(&resolver->uring)) != NULL) {
+        unsigned long long data = cqe->user_data;
+        int res = cqe->res;
+        unsigned int flags = cqe->flags;
+        uring_cqe_seen(&resolver->uring);
+
+        int index = data & 0xffffffff;
+
+        if (data >> 56 == REQUEST_SEND) {
+            resolver_query_t* query = &resolver->slots[index];
+
+            // Query of a failed write may be already finished
+            if (res < 0 && query->active && !query->tcp && query->id == (unsigned short)(data >> 32)) {
+                fail_query(resolver, query);
+            }
+            continue;
+        }
+
+        if (flags & IORING_CQE_F_BUFFER) {
+            unsigned short bid = flags >> IORING_CQE_BUFFER_SHIFT;
+            unsigned char* packet = resolver->uring_bufs + bid * stride;
+
+            if (res > resolver->recv_size) {
+                res = resolver->recv_size;
+                ((dns_header_t*)packet)->tc = 1;
+            }
+
+            if (res > 0) {
+                handle_response(resolver, index, packet, res, 0);
+            }
+
+            uring_provide_buffer(&resolver->uring, packet, stride, bid);
+        }
+
+        // Multishot receive was terminated (e.g. by an ICMP error or lack of buffers), if it cannot
+        // be started again, responses of the server are received by the event loop (`read_responses`)
+        if (!(flags & IORING_CQE_F_MORE) && arm_recv(resolver, index)) {
+            resolver_watch(resolver, &resolver->servers[index].watch, EPOLLIN);
+        }
+    }
+}
+
+/**
+ * @brief Set up the io_uring transport.
+ *
+ * Query slots are registered as a fixed buffer, so queries are written without mapping their
+ * pages on every send, and URING_BUFFERS receive buffers are provided to the kernel.
+ *
+ * @param resolver Pointer to the resolver.
+ * @return 0 on success, -1 if the kernel does not support the required features.
+ */
+static int init_uring(resolver_t* resolver) {
+    // Multishot receive was added in the same release as IORING_OP_SEND_ZC (Linux 6.0)
+    static const int ops[] = { IORING_OP_RECV, IORING_OP_WRITE_FIXED, IORING_OP_SEND_ZC };
+
+    int stride = resolver->recv_size + 1;
+
+    if (uring_init(&resolver->uring, URING_ENTRIES, URING_ENTRIES * 4)) {
+        return -1;
+    }
+
+    int ok = uring_supports(&resolver->uring, ops, sizeof(ops) / sizeof(ops[0])) &&
+             uring_register_buffer(&resolver->uring, resolver->slots, resolver->config.window * sizeof(resolver_query_t)) == 0 &&
+             uring_setup_buf_ring(&resolver->uring, URING_BUFFERS, 0) == 0 &&
+             (resolver->uring_bufs = malloc(URING_BUFFERS * stride)) != NULL;
+
+    for (int i = 0; ok && i < URING_BUFFERS; i++) {
+        uring_provide_buffer(&resolver->uring, resolver->uring_bufs + i * stride, stride, i);
+    }
+
+    resolver->uring_watch.fd = resolver->uring.fd;
+    resolver->uring_watch.handler = reap_completions;
+    resolver->uring_watch.data = NULL;
+
+    if (!ok || resolver_watch(resolver, &resolver->uring_watch, EPOLLIN)) {
+        uring_free(&resolver->uring);
+        free(resolver->uring_bufs);
+        resolver->uring_bufs = NULL;
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Initialize the resolver.
+ *
+ * @param resolver Pointer to the resolver.
+ * @param config Resolver configuration.
+ * @return 0 on success, -1 on failure (errno is set).
+ */
+int resolver_init(resolver_t* resolver, resolver_config_t* config) {
+    memset(resolver, 0, sizeof(resolver_t));
+
+    resolver->config = *config;
+    resolver->uring.fd = -1;
+    resolver->epoll = epoll_create1(0);
+
+    resolver->slots = calloc(config->window, sizeof(resolver_query_t));
+    resolver->free_slots = malloc(config->window * sizeof(int));
+    resolver->heap = malloc(config->window * sizeof(resolver_query_t*));
+    resolver->id_map = malloc(MAX_IDS * sizeof(int));
+    resolver->buffer = malloc(MAX_BUFF);
+
+    // Responses larger than the advertised payload size are truncated anyway
+    resolver->recv_size = config->edns > MAX_QUERY ? config->edns : MAX_QUERY;
+    resolver->recv_ring = malloc(MAX_BATCH * resolver->recv_size);
+
+    if (resolver->epoll == -1 || resolver->slots == NULL || resolver->free_slots == NULL || resolver->heap == NULL ||
+        resolver->id_map == NULL || resolver->buffer == NULL || resolver->recv_ring == NULL) {
+        resolver_free(resolver);
+        return -1;
+    }
+
+    for (int i = 0; i < config->window; i++) {
+        resolver->free_slots[resolver->nfree++] = config->window - 1 - i;
+    }
+
+    for (int i = 0; i < MAX_IDS; i++) {
+        resolver->id_map[i] = -1;
+    }
+
+    for (int i = 0; i < MAX_BATCH; i++) {
+        resolver->recv_iov[i].iov_base = resolver->recv_ring + i * resolver->recv_size;
+        resolver->recv_iov[i].iov_len = resolver->recv_size;
+        resolver->recv_msgs[i].msg_hdr.msg_iov = &resolver->recv_iov[i];
+        resolver->recv_msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+
+    // Classic transport is used if io_uring is not supported
+    if (config->uring) {
+        init_uring(resolver);
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Add a server to the resolver.
+ *
+ * A non-blocking UDP socket connected to the server is created and registered in the event loop.
+ *
+ * @param resolver Pointer to the resolver.
+ * @param server Address of the server.
+ * @return Index of the server, or -1 on failure.
+ */
+int resolver_add_server(resolver_t* resolver, dns_server_t* server) {
+    if (resolver->nservers == MAX_SERVERS) {
+        return -1;
+    }
+
+    int sockt = socket(server->family, SOCK_DGRAM | SOCK_NONBLOCK, IPPROTO_UDP);
+    if (sockt == -1) {
+        return -1;
+    }
+
+    if (connect(sockt, (struct sockaddr*)&server->addr, server->addr_len) == -1) {
+        close(sockt);
+        return -1;
+    }
+
+    resolver_server_t* s = &resolver->servers[resolver->nservers];
+    s->addr = *server;
+
+    // Local address is known once the socket is connected
+    socklen_t local_len = sizeof(s->local);
+    memset(&s->local, 0, sizeof(s->local));
+    getsockname(sockt, (struct sockaddr*)&s->local, &local_len);
+
+    s->srtt = 0;
+    s->samples = 0;
+    memset(&s->tcp, 0, sizeof(resolver_tcp_t));
+    s->tcp.watch.fd = -1;
+    s->watch.fd = sockt;
+    s->watch.handler = read_responses;
+    s->watch.data = s;
+
+    // Socket is watched by the event loop without io_uring, or if its multishot receive cannot be started
+    if ((resolver->uring.fd == -1 || arm_recv(resolver, resolver->nservers)) && resolver_watch(resolver, &s->watch, EPOLLIN)) {
+        close(sockt);
+        return -1;
+    }
+
+    return resolver->nservers++;
+}
+
+/**
+ * @brief Submit a query.
+ *
+ * The query is sent immediately if the number of outstanding queries is lower than the window,
+ * otherwise it waits in a queue. The callback is called exactly once, when the query is finished.
+ *
+ * @param resolver Pointer to the resolver.
+ * @param name Name to be queried.
+ * @param qtype Type of the query.
+ * @param callback Completion callback.
+ * @param data User data for the callback.
+ * @return 0 on success, -1 if no server was added or memory could not be allocated.
+ */
+int resolver_submit(resolver_t* resolver, const char* name, unsigned short qtype, resolver_callback_t callback, void* data) {
+    if (resolver->nservers == 0) {
+        return -1;
+    }
+
+    if (resolver->nfree > 0 && resolver->queue_head == NULL) {
+        start_query(resolver, name, qtype, callback, data);
+        return 0;
+    }
+
+    resolver_queued_t* queued = malloc(sizeof(resolver_queued_t));
+    if (queued == NULL) {
+        return -1;
+    }
+
+    strncpy(queued->name, name, MAX_NAME - 1);
+    queued->name[MAX_NAME - 1] = 0;
+    queued->qtype = qtype;
+    queued->callback = callback;
+    queued->data = data;
+    queued->next = NULL;
+
+    if (resolver->queue_tail != NULL) {
+        resolver->queue_tail->next = queued;
+    }
+    else {
+        resolver->queue_head = queued;
+    }
+    resolver->queue_tail = queued;
+    resolver->nqueued++;
+
+    return 0;
+}
+
+/**
+ * @brief Run a single iteration of the event loop.
+ *
+ * This function waits until a watched file descriptor is ready, the earliest outstanding query
+ * times out or the timeout elapses. Ready descriptors are handled, responses are matched to
+ * their queries and timed out queries are finished with `E_TIMEOUT`.
+ *
+ * @param resolver Pointer to the resolver.
+ * @param timeout Maximum time to wait in milliseconds (-1 to wait for the next event or timer).
+ * @return 0 on success, E_RECVFROM if the event loop failed.
+ */
+int resolver_run(resolver_t* resolver, int timeout) {
+    start_queued(resolver);
+    flush_sends(resolver);
+
+    // Wait at most until the earliest deadline
+    if (resolver->nheap > 0) {
+        long long remaining = resolver->heap[0]->deadline - resolver_now();
+        remaining = remaining > 0 ? remaining : 0;
+
+        if (timeout < 0 || remaining < timeout) {
+            timeout = (int)remaining;
+        }
+    }
+
+    struct epoll_event events[MAX_EVENTS];
+
+    int n = epoll_wait(resolver->epoll, events, MAX_EVENTS, timeout);
+    if (n < 0 && errno != EINTR) {
+        return E_RECVFROM;
+    }
+
+    for (int i = 0; i < n; i++) {
+        resolver_watch_t* watch = events[i].data.ptr;
+        watch->handler(resolver, watch, events[i].events);
+    }
+
+    // Retransmit or finish timed out queries
+    long long now = resolver_now();
+    while (resolver->nheap > 0 && resolver->heap[0]->deadline <= now) {
+        expire_query(resolver, resolver->heap[0]);
+    }
+
+    start_queued(resolver);
+
+    return 0;
+}
+
+/**
+ * @brief Get the number of unfinished queries (outstanding and queued).
+ *
+ * @param resolver Pointer to the resolver.
+ * @return Number of unfinished queries.
+ */
+int resolver_pending(resolver_t* resolver) {
+    return resolver->config.window - resolver->nfree + resolver->nqueued;
+}
+
+/**
+ * @brief Register a file descriptor in the event loop of the resolver.
+ *
+ * @param resolver Pointer to the resolver.
+ * @param watch Watch (must stay valid until it is unregistered).
+ * @param events Epoll events to wait for.
+ * @return 0 on success, -1 on failure.
+ */
+int resolver_watch(resolver_t* resolver, resolver_watch_t* watch, unsigned int events) {
+    struct epoll_event event = { .events = events, .data.ptr = watch };
+
+    if (epoll_ctl(resolver->epoll, EPOLL_CTL_ADD, watch->fd, &event) == 0) {
+        return 0;
+    }
+
+    // Already registered, update events
+    return epoll_ctl(resolver->epoll, EPOLL_CTL_MOD, watch->fd, &event);
+}
+
+/**
+ * @brief Unregister a file descriptor from the event loop of the resolver.
+ *
+ * @param resolver Pointer to the resolver.
+ * @param watch Registered watch.
+ */
+void resolver_unwatch(resolver_t* resolver, resolver_watch_t* watch) {
+    epoll_ctl(resolver->epoll, EPOLL_CTL_DEL, watch->fd, NULL);
+}
+
+/**
+ * @brief Free resources of the resolver.
+ *
+ * Unfinished queries are dropped without calling their callbacks.
+ *
+ * @param resolver Pointer to the resolver.
+ */
+void resolver_free(resolver_t* resolver) {
+    if (resolver->uring.fd != -1) {
+        uring_free(&resolver->uring);
+    }
+    free(resolver->uring_bufs);
+
+    for (int i = 0; i < resolver->nservers; i++) {
+        close(resolver->servers[i].watch.fd);
+
+        if (resolver->servers[i].tcp.watch.fd != -1) {
+            close(resolver->servers[i].tcp.watch.fd);
+        }
+        free(resolver->servers[i].tcp.in);
+        free(resolver->servers[i].tcp.out);
+    }
+
+    while (resolver->queue_head != NULL) {
+        resolver_queued_t* next = resolver->queue_head->next;
+        free(resolver->queue_head);
+        resolver->queue_head = next;
+    }
+
+    if (resolver->epoll != -1) {
+        close(resolver->epoll);
+    }
+
+    free(resolver->slots);
+    free(resolver->free_slots);
+    free(resolver->heap);
+    free(resolver->id_map);
+    free(resolver->buffer);
+    free(resolver->recv_ring);
+
+    memset(resolver, 0, sizeof(resolver_t));
+    resolver->epoll = -1;
+    resolver->uring.fd = -1;
+}
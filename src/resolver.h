@@ -0,0 +1,198 @@
+/**
+ * @file resolver.h
+ * @brief Asynchronous Resolver Engine Header
+ *
+ * This C header file, "resolver.h" defines the structures and the C API of the asynchronous
+ * resolver engine. The engine is driven by epoll on a single thread, every server has its own
+ * non-blocking UDP socket and every outstanding query has its own timer in a binary heap, so
+ * many queries across several servers progress concurrently.
+ *
+ * Unanswered queries are retransmitted with exponential backoff. Every transmission goes to the
+ * server with the lowest smoothed RTT that was not tried yet by the query, so a failing server
+ * is avoided by both the retransmissions and subsequent queries.
+ *
+ * Truncated responses are retried over TCP (or all queries are sent over TCP if configured).
+ * Every server has at most one TCP connection, that is reused by subsequent queries and carries
+ * many pipelined queries at once (RFC 7766).
+ *
+ * UDP queries are sent and responses received in batches (`sendmmsg`, `recvmmsg`). Optionally,
+ * an io_uring transport is used instead: queries are written from registered buffers and every
+ * server socket has a multishot receive, that places responses into provided buffers without
+ * a syscall per packet. Completions are reaped when the ring becomes readable in the event loop.
+ *
+ * Typical usage:
+ * - `resolver_init` with a configuration,
+ * - `resolver_add_server` for every server,
+ * - `resolver_submit` for every query (callback is called once the query is finished),
+ * - `resolver_run` until `resolver_pending` returns 0,
+ * - `resolver_free`.
+ *
+ * If a cache is configured, queries are answered from the cache when possible and received
+ * responses are stored in it. If a capture is configured, every transmitted query and every
+ * received response is recorded in it.
+ *
+ * Other file descriptors (e.g. listening sockets of a daemon) can be driven by the same event
+ * loop using `resolver_watch`.
+ *
+ * @author Oleksandr Turytsia (xturyt00)
+ * @date October 18, 2023
+ */
+#ifndef RESOLVER_H
+#define RESOLVER_H
+
+#include "dns.h"
+#include "cache.h"
+#include "uring.h"
+#include "capture.h"
+
+#define MAX_QUERY 512
+#define MAX_BATCH 32
+#define MAX_IDS 65536
+#define RANDOM_IDS 256
+#define MAX_EVENTS 64
+
+// Kinds of io_uring requests (stored in the top byte of the user data)
+#define REQUEST_RECV 1ULL
+#define REQUEST_SEND 2ULL
+
+typedef struct resolver resolver_t;
+typedef struct resolver_watch resolver_watch_t;
+
+// Result of a finished query
+typedef struct {
+    int err;                        // Error code (0 on success, see error.h)
+    const char* name;               // Queried name
+    unsigned short qtype;           // Type of the query
+    unsigned char* packet;          // Response packet (NULL on error), valid only inside the callback
+    int len;                        // Length of the response packet
+    int qname_size;                 // Length of the QNAME in the question section
+    int server;                     // Index of the server that answered (-1 if none)
+} resolver_result_t;
+
+// Function called once the query is finished
+typedef void (*resolver_callback_t)(resolver_t* resolver, resolver_result_t* result, void* data);
+
+// Function called when a watched file descriptor is ready
+typedef void (*resolver_handler_t)(resolver_t* resolver, resolver_watch_t* watch, unsigned int events);
+
+// File descriptor driven by the event loop of the resolver
+struct resolver_watch {
+    int fd;                         // Watched file descriptor
+    resolver_handler_t handler;     // Function called when the descriptor is ready
+    void* data;                     // User data for the handler
+};
+
+// Resolver configuration
+typedef struct {
+    int window;                     // Maximum number of outstanding queries
+    int recursive;                  // Recursion Desired flag of queries
+    int lowercase;                  // Send names of queries in lowercase
+    int timeout;                    // Timeout of the first transmission in milliseconds (doubled by every retransmission)
+    int retries;                    // Number of retransmissions of a query
+    int tcp;                        // Send all queries over TCP
+    int uring;                      // Use the io_uring transport for UDP (if supported by the kernel)
+    int edns;                       // UDP payload size advertised by EDNS(0) (0 to disable)
+    cache_t* cache;                 // Response cache (NULL if disabled)
+    capture_t* capture;             // Capture of sent queries and received responses (NULL if disabled)
+} resolver_config_t;
+
+// TCP connection to a server
+typedef struct {
+    resolver_watch_t watch;         // Non-blocking TCP socket (-1 if not connected)
+    int connecting;                 // Connection is not established yet
+    int writing;                    // Waiting until the socket is writable
+    int generation;                 // Incremented whenever the connection is closed
+    unsigned char* in;              // Partially received responses (with length prefixes)
+    int inlen;                      // Number of bytes in the input buffer
+    unsigned char* out;             // Queries that could not be written yet (with length prefixes)
+    int outlen;                     // Number of bytes in the output buffer
+    int outcap;                     // Size of the output buffer
+} resolver_tcp_t;
+
+// Server used by the resolver
+typedef struct {
+    dns_server_t addr;              // Address of the server
+    struct sockaddr_storage local;  // Local address of the UDP socket
+    resolver_watch_t watch;         // Non-blocking UDP socket connected to the server
+    resolver_tcp_t tcp;             // TCP connection to the server
+    long long srtt;                 // Smoothed RTT in microseconds (0 if the server was not used yet)
+    int samples;                    // Number of RTT samples
+    struct resolver_query* sendq[MAX_BATCH];  // UDP queries waiting to be sent
+    int nsendq;                     // Number of queries waiting to be sent
+} resolver_server_t;
+
+// Query submitted to the resolver
+typedef struct resolver_query {
+    int active;                     // Slot is used by an outstanding query
+    unsigned short id;              // Identifier of the query (host byte order)
+    int server;                     // Index of the server the query was last sent to
+    unsigned int tried;             // Servers the query was sent to (bit per server index)
+    int attempt;                    // Number of retransmissions
+    int tcp;                        // Query is sent over TCP
+    int err;                        // Error of the last transmission (0 if it was sent)
+    long long sent;                 // Time of the last transmission (us, CLOCK_MONOTONIC)
+    char name[MAX_NAME];            // Queried name
+    unsigned short qtype;           // Type of the query
+    unsigned char query[MAX_QUERY]; // Query packet
+    int qlen;                       // Length of the query packet
+    int qname_size;                 // Length of the QNAME in the query packet
+    long long deadline;             // Time when the query times out (ms, CLOCK_MONOTONIC)
+    int heap_index;                 // Position of the query in the timer heap
+    resolver_callback_t callback;   // Completion callback
+    void* data;                     // User data for the callback
+} resolver_query_t;
+
+// Query waiting for a free slot
+typedef struct resolver_queued {
+    char name[MAX_NAME];            // Queried name
+    unsigned short qtype;           // Type of the query
+    resolver_callback_t callback;   // Completion callback
+    void* data;                     // User data for the callback
+    struct resolver_queued* next;   // Next queued query
+} resolver_queued_t;
+
+struct resolver {
+    resolver_config_t config;       // Configuration
+
+    int epoll;                      // Epoll instance of the event loop
+    resolver_server_t servers[MAX_SERVERS];
+    int nservers;                   // Number of servers
+    int next_server;                // First candidate of the next server selection
+
+    resolver_query_t* slots;        // Slots for outstanding queries
+    int* free_slots;                // Stack of free slot indexes
+    int nfree;                      // Number of free slots
+    int* id_map;                    // Query id -> slot index (-1 if the id is not used)
+    unsigned short ids[RANDOM_IDS]; // Pool of random ids
+    int nids;                       // Number of unused ids in the pool
+
+    resolver_query_t** heap;        // Timer heap of outstanding queries (earliest deadline first)
+    int nheap;                      // Number of queries in the heap
+
+    resolver_queued_t* queue_head;  // Queries waiting for a free slot
+    resolver_queued_t* queue_tail;
+    int nqueued;                    // Number of queries waiting for a free slot
+
+    unsigned char* buffer;          // Buffer for cached responses
+    struct mmsghdr recv_msgs[MAX_BATCH];  // Headers of received UDP responses
+    struct iovec recv_iov[MAX_BATCH];
+    unsigned char* recv_ring;       // MAX_BATCH slots of recv_size bytes for received responses
+    int recv_size;                  // Size of a receive slot
+
+    uring_t uring;                  // io_uring transport (fd is -1 if not used)
+    resolver_watch_t uring_watch;   // Watch of the ring in the event loop
+    unsigned char* uring_bufs;      // URING_BUFFERS provided buffers of recv_size bytes
+    void* data;                     // User data of the application
+};
+
+int resolver_init(resolver_t* resolver, resolver_config_t* config);
+int resolver_add_server(resolver_t* resolver, dns_server_t* server);
+int resolver_submit(resolver_t* resolver, const char* name, unsigned short qtype, resolver_callback_t callback, void* data);
+int resolver_run(resolver_t* resolver, int timeout);
+int resolver_pending(resolver_t* resolver);
+int resolver_watch(resolver_t* resolver, resolver_watch_t* watch, unsigned int events);
+void resolver_unwatch(resolver_t* resolver, resolver_watch_t* watch);
+void resolver_free(resolver_t* resolver);
+long long resolver_now(void);
+
+#endif
@@ -0,0 +1,259 @@
+/**
+ * @file response.c
+ * @brief DNS Response Parsing and Printing
+ *
+ * This C source file, "response.c" contains functions for parsing DNS responses and printing
+ * them in a human-readable format. It prints the response header flags followed by question,
+ * answer, authority and additional sections.
+ *
+ * @author Oleksandr Turytsia (xturyt00)
+ * @date October 18, 2023
+ */
+#include "parse.h"
+#include "rdata.h"
+
+/**
+ * @brief Get the mnemonic of a type, unknown types are named `TYPEnnn` (RFC 3597).
+ *
+ * @param type Type code.
+ * @param buffer Buffer of at least 16 bytes for the name of an unknown type.
+ * @return Name of the type.
+ */
+static const char* type_text(unsigned short type, char* buffer) {
+    const rdata_type_t* rdata_type = get_rdata_type(type);
+    if (rdata_type != NULL) {
+        return rdata_type->name;
+    }
+
+    sprintf(buffer, "TYPE%u", type);
+    return buffer;
+}
+
+/**
+ * @brief Print a DNS response.
+ *
+ * This function validates the response code of a received DNS response and prints its
+ * header flags followed by question, answer, authority and additional sections. Records are
+ * taken from the record index of the message (see parse.h), so every section starts exactly
+ * where the previous one ends.
+ *
+ * @param buffer Pointer to the DNS packet buffer.
+ * @param len Length of the DNS packet.
+ * @param is_test Hide TTL values (testing mode).
+ * @return 0 on success, otherwise an rcode error (see error.h).
+ */
+int print_response(unsigned char* buffer, int len, int is_test) {
+    const int dns_question_size = sizeof(dns_question_t);
+    static const char* section_names[3] = { "Answer", "Authority", "Additional" };
+
+    if (len < (int)sizeof(dns_header_t)) {
+        return E_FORMAT;
+    }
+
+    // Extract the DNS header
+    dns_header_t* dns_header = (dns_header_t*)buffer;
+
+    // RFC 1035 response codes 1-5 are mapped to error codes 31-35
+    if (dns_header->rcode >= RCODE_FORMAT_ERROR && dns_header->rcode <= RCODE_REFUCED) {
+        return E_FORMAT + dns_header->rcode - RCODE_FORMAT_ERROR;
+    }
+
+    dns_message_t message;
+    if (parse_message(&message, buffer, len)) {
+        return E_FORMAT;
+    }
+
+    char qname[MAX_NAME];
+
+    // Validate all questions first, the header is printed only for a well-formed question section
+    int offset = sizeof(dns_header_t);
+    for (int i = 0; i < message.qdcount; i++) {
+        offset = parse_domain_name(buffer, len, offset, qname);
+        if (offset == -1) {
+            return E_FORMAT;
+        }
+        offset += dns_question_size;
+    }
+
+    printf("Authoritative: %s, Recursive: %s, Truncated: %s\n",  bool_to_yes_no(dns_header->aa), bool_to_yes_no(dns_header->rd), bool_to_yes_no(dns_header->tc));
+    printf("Question section (%d)\n", message.qdcount);
+
+    // Every question is QNAME followed by QTYPE and QCLASS
+    offset = sizeof(dns_header_t);
+    for (int i = 0; i < message.qdcount; i++) {
+        offset = parse_domain_name(buffer, len, offset, qname);
+
+        dns_question_t* dns_question = (dns_question_t*)(buffer + offset);
+        char type[16];
+        printf(" %s, %s, %s\n", qname, type_text(ntohs(dns_question->qtype), type), get_dns_class(ntohs(dns_question->qclass)));
+
+        offset += dns_question_size;
+    }
+
+    // Records of the index are ordered by sections
+    int record = 0;
+    for (int section = SECTION_ANSWER; section <= SECTION_ADDITIONAL; section++) {
+        printf("%s section (%d)\n", section_names[section], message.counts[section]);
+
+        for (int i = 0; i < message.counts[section]; i++) {
+            if (print_record(&message, &message.records[record++], is_test)) {
+                return E_FORMAT;
+            }
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Print a DNS Resource Record (RR)
+ *
+ * This function prints the details of a record of the record index, such as name, type, class,
+ * TTL, and data content.
+ *
+ * @param message Record index of the DNS packet.
+ * @param record Record to be printed.
+ * @param is_test Hide TTL values (testing mode).
+ * @return 0 on success, -1 if the owner name is malformed.
+ */
+int print_record(dns_message_t* message, dns_record_t* record, int is_test) {
+    // OPT pseudo-record has a different meaning of CLASS and TTL fields
+    if (record->type == OPT) {
+        print_opt_data(message->packet + record->rdata - sizeof(dns_rr_t));
+        return 0;
+    }
+
+    char name[MAX_NAME];
+    if (parse_domain_name(message->packet, message->len, record->name, name) == -1) {
+        return -1;
+    }
+
+    // Data is decoded by the decoder of the type (see rdata.h)
+    char small[RDATA_SMALL];
+    char* data = format_rdata(small, sizeof(small), message->packet, message->len, record->type, record->rdata, record->rdlength, ", ");
+
+    // Print RR information: name, type, class, TTL, and data
+    char type[16];
+    printf(" %s, %s, %s, %d, %s\n", name, type_text(record->type, type), get_dns_class(record->class), is_test ? 0 : record->ttl, data);
+
+    if (data != small) {
+        free(data);
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Print an EDNS(0) OPT pseudo-record
+ *
+ * This function prints the UDP payload size, the extended RCODE, the EDNS version, the DO flag
+ * and the codes and lengths of options of an OPT record (RFC 6891).
+ *
+ * @param pointer Pointer to the fixed part of the OPT record (right after the owner name).
+ */
+void print_opt_data(unsigned char* pointer) {
+    dns_rr_t* opt = (dns_rr_t*)pointer;
+    unsigned int ttl = ntohl(opt->ttl);
+
+    printf(" ., OPT, payload %d, extended rcode %d, version %d, DO %d", ntohs(opt->class), ttl >> 24, (ttl >> 16) & 0xFF, (ttl >> 15) & 1);
+
+    // Options are stored as code, length and data
+    unsigned char* option = pointer + sizeof(dns_rr_t);
+    int left = ntohs(opt->rdlength);
+
+    while (left >= 4) {
+        int code = (option[0] << 8) | option[1];
+        int length = (option[2] << 8) | option[3];
+
+        if (length + 4 > left) {
+            break;
+        }
+
+        printf(", option %d (%d bytes)", code, length);
+
+        option += length + 4;
+        left -= length + 4;
+    }
+
+    printf("\n");
+}
+
+/**
+ * @brief Parse a domain name from DNS response data.
+ *
+ * This function parses a domain name from DNS response data and constructs the result
+ * in a human-readable format. It handles both regular domain names and domain name compression.
+ *
+ * The name is decoded iteratively in a single pass. Every offset is validated against the length
+ * of the packet, compression pointers must point backwards and their number is limited, and the
+ * decoded name is limited to 255 octets (RFC 1035 2.3.4), so a malformed packet can neither loop
+ * nor overflow the result.
+ *
+ * @param buffer Pointer to the DNS packet buffer.
+ * @param len Length of the DNS packet.
+ * @param offset Offset of the domain name in the packet.
+ * @param result Buffer of size MAX_NAME to store the parsed domain name as a human-readable string.
+ * @return Offset right after the domain name (after the first compression pointer), or -1 if
+ * the name is malformed.
+ */
+int parse_domain_name(unsigned char* buffer, int len, int offset, char* result) {
+    int end = -1;                   // Offset after the name, known after the first pointer
+    int size = 0;                   // Length of the decoded name (write cursor)
+    int wire = 1;                   // Length of the name in wire format (including the root label)
+    int jumps = 0;                  // Number of followed compression pointers
+    int limit = offset;             // Compression pointers must point before this offset
+
+    while (1) {
+        if (offset >= len) {
+            return -1;
+        }
+
+        unsigned int label = buffer[offset];
+
+        // End of the domain name
+        if (label == 0) {
+            offset++;
+            break;
+        }
+
+        // Check for message compression (The first two bits are ones)
+        // 11XX XXXX & 1100 0000 == 1100 0000
+        if ((label & 192) == 192) {
+            if (offset + 1 >= len || ++jumps > MAX_POINTERS) {
+                return -1;
+            }
+
+            // A pointer to another location in the packet
+            int target = ((label & 63) << 8) | buffer[offset + 1];
+            if (target >= limit) {
+                return -1;
+            }
+
+            if (end == -1) {
+                end = offset + 2;
+            }
+
+            offset = limit = target;
+            continue;
+        }
+
+        // Label types 01 and 10 are not used
+        if ((label & 192) != 0 || offset + 1 + (int)label > len) {
+            return -1;
+        }
+
+        wire += label + 1;
+        if (wire > MAX_WIRE_NAME) {
+            return -1;
+        }
+
+        memcpy(result + size, buffer + offset + 1, label);
+        size += label;
+        result[size++] = '.';
+        offset += label + 1;
+    }
+
+    result[size] = 0;
+
+    return end == -1 ? offset : end;
+}
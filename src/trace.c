@@ -0,0 +1,516 @@
+/**
+ * @file trace.c
+ * @brief Iterative Resolution Implementation
+ *
+ * This C source file, "trace.c" contains the implementation of the iterative resolution mode.
+ * Every step creates a resolver for the servers of the closest known zone, sends the query
+ * (Recursion Desired = 0) to several of them at once and follows the referral of the first usable
+ * response. Every step is printed with the zone, the server that answered and the time of the
+ * response, followed by the response in the standard output format.
+ *
+ * @author Oleksandr Turytsia (xturyt00)
+ * @date October 18, 2023
+ */
+#include "trace.h"
+#include "batch.h"
+
+/**
+ * @brief Get the current time in microseconds (CLOCK_MONOTONIC).
+ *
+ * @return Current time in microseconds.
+ */
+static long long trace_now_us(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (long long)now.tv_sec * 1000000 + now.tv_nsec / 1000;
+}
+
+/**
+ * @brief Check whether a name is equal to a zone or below it.
+ *
+ * @param name Normalized name (see `normalize_cache_key`).
+ * @param zone Normalized name of the zone.
+ * @return 1 if the name belongs to the zone, 0 otherwise.
+ */
+static int is_subdomain(const char* name, const char* zone) {
+    if (strcmp(zone, ".") == 0) {
+        return 1;
+    }
+
+    int name_len = strlen(name);
+    int zone_len = strlen(zone);
+
+    if (name_len < zone_len || strcmp(name + name_len - zone_len, zone) != 0) {
+        return 0;
+    }
+
+    return name_len == zone_len || name[name_len - zone_len - 1] == '.';
+}
+
+/**
+ * @brief Create a server address from an address record.
+ *
+ * @param args Pointer to the program's command-line arguments (port of the servers).
+ * @param family Address family (AF_INET or AF_INET6).
+ * @param addr Address in network byte order.
+ * @param server Where the server will be stored.
+ */
+static void make_server(args_t* args, int family, const unsigned char* addr, dns_server_t* server) {
+    memset(server, 0, sizeof(dns_server_t));
+    server->family = family;
+
+    if (family == AF_INET) {
+        struct sockaddr_in* in = (struct sockaddr_in*)&server->addr;
+        in->sin_family = AF_INET;
+        in->sin_port = htons(atoi(args->port));
+        memcpy(&in->sin_addr, addr, sizeof(struct in_addr));
+        server->addr_len = sizeof(struct sockaddr_in);
+    }
+    else {
+        struct sockaddr_in6* in6 = (struct sockaddr_in6*)&server->addr;
+        in6->sin6_family = AF_INET6;
+        in6->sin6_port = htons(atoi(args->port));
+        memcpy(&in6->sin6_addr, addr, sizeof(struct in6_addr));
+        server->addr_len = sizeof(struct sockaddr_in6);
+    }
+}
+
+/**
+ * @brief Load root hints.
+ *
+ * Every line of the file is either an IP address, or a record in the zone file format of
+ * `named.root` (only A and AAAA records are used). Comments start with `;` or `#`.
+ *
+ * @param args Pointer to the program's command-line arguments (port of the servers).
+ * @param path Path of the file.
+ * @param servers Array of MAX_SERVERS servers where the root servers will be stored.
+ * @return Number of loaded servers, or -1 if the file could not be opened.
+ */
+int load_root_hints(args_t* args, const char* path, dns_server_t* servers) {
+    FILE* input = fopen(path, "r");
+    if (input == NULL) {
+        return -1;
+    }
+
+    char line[MAX_LINE];
+    int count = 0;
+
+    while (count < MAX_SERVERS && fgets(line, MAX_LINE, input) != NULL) {
+        line[strcspn(line, ";#")] = 0;
+
+        char* tokens[8];
+        int ntokens = 0;
+
+        for (char* token = strtok(line, " \t\r\n"); token != NULL && ntokens < 8; token = strtok(NULL, " \t\r\n")) {
+            tokens[ntokens++] = token;
+        }
+
+        // Plain address, or an address record (name [ttl] [class] type address)
+        const char* text = NULL;
+        if (ntokens == 1) {
+            text = tokens[0];
+        }
+        else if (ntokens >= 3 && (strcasecmp(tokens[ntokens - 2], "A") == 0 || strcasecmp(tokens[ntokens - 2], "AAAA") == 0)) {
+            text = tokens[ntokens - 1];
+        }
+
+        unsigned char addr[sizeof(struct in6_addr)];
+
+        if (text != NULL && inet_pton(AF_INET, text, addr) == 1) {
+            make_server(args, AF_INET, addr, &servers[count++]);
+        }
+        else if (text != NULL && inet_pton(AF_INET6, text, addr) == 1) {
+            make_server(args, AF_INET6, addr, &servers[count++]);
+        }
+    }
+
+    fclose(input);
+
+    return count;
+}
+
+/**
+ * @brief Add a delegation to the cache.
+ *
+ * @param trace Pointer to the state of the iterative resolution.
+ * @param zone Normalized name of the zone.
+ * @param servers Authoritative servers of the zone.
+ * @param nservers Number of servers.
+ * @return Index of the delegation.
+ */
+static int add_zone(trace_t* trace, const char* zone, dns_server_t* servers, int nservers) {
+    if (trace->nzones == trace->capacity) {
+        trace->capacity = trace->capacity ? trace->capacity * 2 : 16;
+        trace->zones = realloc(trace->zones, trace->capacity * sizeof(trace_zone_t));
+        if (trace->zones == NULL) {
+            exit_error(E_EAI, strerror(errno));
+        }
+    }
+
+    trace_zone_t* entry = &trace->zones[trace->nzones];
+    strcpy(entry->zone, zone);
+    memcpy(entry->servers, servers, nservers * sizeof(dns_server_t));
+    entry->nservers = nservers;
+
+    return trace->nzones++;
+}
+
+/**
+ * @brief Find the closest cached zone of a name.
+ *
+ * @param trace Pointer to the state of the iterative resolution.
+ * @param name Normalized name.
+ * @return Index of the longest cached zone containing the name (the root zone at least).
+ */
+static int find_zone(trace_t* trace, const char* name) {
+    int best = 0;
+
+    for (int i = 1; i < trace->nzones; i++) {
+        if (is_subdomain(name, trace->zones[i].zone) && (best == 0 || strlen(trace->zones[i].zone) > strlen(trace->zones[best].zone))) {
+            best = i;
+        }
+    }
+
+    return best;
+}
+
+/**
+ * @brief Store the first usable response of a step.
+ *
+ * Callback of the resolver of a step. Server failures and refusals are kept only until another
+ * server answers.
+ *
+ * @param resolver Pointer to the resolver.
+ * @param result Result of the query.
+ * @param data Pointer to the step.
+ */
+static void finish_step(resolver_t* resolver, resolver_result_t* result, void* data) {
+    trace_step_t* step = data;
+    (void)resolver;
+
+    if (step->done) {
+        return;
+    }
+
+    if (result->err) {
+        step->err = result->err;
+        return;
+    }
+
+    int rcode = ((dns_header_t*)result->packet)->rcode;
+    step->done = rcode != RCODE_SERVER_FAILURE && rcode != RCODE_NOT_IMPLEMENTED && rcode != RCODE_REFUCED;
+
+    memcpy(step->packet, result->packet, result->len);
+    step->len = result->len;
+    step->server = result->server;
+    step->rtt = trace_now_us() - step->started;
+}
+
+/**
+ * @brief Send a query to servers of a zone and wait for the first usable response.
+ *
+ * The query is submitted once for each of up to TRACE_RACE servers. A server that was not used
+ * yet is always preferred by the resolver, so the copies are sent to different servers at once,
+ * remaining copies are dropped once the first response arrives.
+ *
+ * @param trace Pointer to the state of the iterative resolution.
+ * @param zone Index of the zone.
+ * @param name Name to be queried.
+ * @param qtype Type of the query.
+ * @param step Where the response will be stored.
+ * @return 0 if a response was received, otherwise an error code (see error.h).
+ */
+static int race_step(trace_t* trace, int zone, const char* name, unsigned short qtype, trace_step_t* step) {
+    trace_zone_t* entry = &trace->zones[zone];
+
+    resolver_config_t config = {
+        .window = TRACE_RACE,
+        .recursive = 0,
+        .timeout = trace->args->timeout,
+        .retries = trace->args->retries,
+        .tcp = trace->args->tcp,
+        .edns = trace->args->edns,
+        .capture = trace->capture,
+    };
+
+    resolver_t resolver;
+    if (resolver_init(&resolver, &config)) {
+        return E_EAI;
+    }
+
+    // Servers of an unreachable address family are left out
+    dns_server_t* servers[MAX_SERVERS];
+    for (int i = 0; i < entry->nservers; i++) {
+        if (resolver_add_server(&resolver, &entry->servers[i]) != -1) {
+            servers[resolver.nservers - 1] = &entry->servers[i];
+        }
+    }
+
+    if (resolver.nservers == 0) {
+        resolver_free(&resolver);
+        return E_SOCK;
+    }
+
+    int copies = resolver.nservers < TRACE_RACE ? resolver.nservers : TRACE_RACE;
+    step->started = trace_now_us();
+    step->err = E_TIMEOUT;
+
+    // Only accepted copies are raced, the step fails if none was submitted
+    int submitted = 0;
+    for (int i = 0; i < copies; i++) {
+        if (resolver_submit(&resolver, name, qtype, finish_step, step) == 0) {
+            submitted++;
+        }
+    }
+
+    if (submitted == 0) {
+        resolver_free(&resolver);
+        return E_EAI;
+    }
+
+    int err = 0;
+    while (!err && !step->done && resolver_pending(&resolver) > 0) {
+        err = resolver_run(&resolver, -1);
+    }
+
+    if (step->len > 0) {
+        step->server = servers[step->server] - entry->servers;
+    }
+
+    resolver_free(&resolver);
+
+    if (err) {
+        return err;
+    }
+
+    return step->len > 0 ? 0 : step->err;
+}
+
+/**
+ * @brief Print a step of the iterative resolution.
+ *
+ * @param trace Pointer to the state of the iterative resolution.
+ * @param zone Index of the zone.
+ * @param step Finished step.
+ * @return Error code of the response (see `print_response`).
+ */
+static int print_step(trace_t* trace, int zone, trace_step_t* step) {
+    dns_server_t* server = &trace->zones[zone].servers[step->server];
+    char addr[INET6_ADDRSTRLEN];
+
+    if (server->family == AF_INET) {
+        inet_ntop(AF_INET, &((struct sockaddr_in*)&server->addr)->sin_addr, addr, sizeof(addr));
+    }
+    else {
+        inet_ntop(AF_INET6, &((struct sockaddr_in6*)&server->addr)->sin6_addr, addr, sizeof(addr));
+    }
+
+    // Zones are printed as absolute names
+    const char* name = trace->zones[zone].zone;
+    long long rtt = trace->args->test ? 0 : step->rtt;
+    printf("Step (%d): %s%s at %s, %lld.%03lld ms\n", ++trace->step, name, strcmp(name, ".") == 0 ? "" : ".", addr, rtt / 1000, rtt % 1000);
+
+    int err = print_response(step->packet, step->len, trace->args->test);
+    if (err) {
+        printf("Error: %s\n", get_error_message(err));
+    }
+
+    return err;
+}
+
+static int trace_name(trace_t* trace, const char* name, unsigned short qtype, int depth, dns_server_t* found, int* nfound);
+
+/**
+ * @brief Follow a referral.
+ *
+ * A referral is a response without answers with NS records of a zone below the current zone
+ * in the authority section. Addresses of its servers are taken from glue records, or resolved
+ * iteratively if the referral has no glue.
+ *
+ * @param trace Pointer to the state of the iterative resolution.
+ * @param zone Index of the current zone.
+ * @param name Normalized queried name.
+ * @param message Parsed response.
+ * @param depth Depth of the resolution (0 for the queried name).
+ * @return Index of the delegated zone, -1 if the response is not a referral, -2 if the referral
+ * cannot be followed.
+ */
+static int follow_referral(trace_t* trace, int zone, const char* name, dns_message_t* message, int depth) {
+    if (((dns_header_t*)message->packet)->rcode != 0 || message->counts[SECTION_ANSWER] > 0) {
+        return -1;
+    }
+
+    char child[MAX_NAME] = { 0 };
+    char targets[MAX_SERVERS][MAX_NAME];
+    int ntargets = 0;
+    char owner[MAX_NAME];
+    char key[MAX_NAME];
+
+    // NS records of the first zone below the current zone
+    for (int i = 0; i < message->nrecords; i++) {
+        dns_record_t* record = &message->records[i];
+
+        if (record->section != SECTION_AUTHORITY || record->type != NS ||
+            parse_domain_name(message->packet, message->len, record->name, owner) == -1) {
+            continue;
+        }
+
+        normalize_cache_key(key, owner);
+
+        if (child[0] == 0) {
+            if (strcmp(key, trace->zones[zone].zone) == 0 || !is_subdomain(key, trace->zones[zone].zone) ||
+                !is_subdomain(name, key)) {
+                continue;
+            }
+            strcpy(child, key);
+        }
+
+        if (strcmp(key, child) != 0 || ntargets == MAX_SERVERS ||
+            parse_domain_name(message->packet, message->len, record->rdata, owner) == -1) {
+            continue;
+        }
+
+        normalize_cache_key(targets[ntargets++], owner);
+    }
+
+    if (child[0] == 0) {
+        return -1;
+    }
+
+    dns_server_t servers[MAX_SERVERS];
+    int nservers = 0;
+
+    // Glue records, IPv4 addresses first
+    for (int family = AF_INET; family != -1; family = family == AF_INET ? AF_INET6 : -1) {
+        for (int i = 0; i < message->nrecords && nservers < MAX_SERVERS; i++) {
+            dns_record_t* record = &message->records[i];
+            unsigned short type = family == AF_INET ? A : AAAA;
+            unsigned short size = family == AF_INET ? sizeof(struct in_addr) : sizeof(struct in6_addr);
+
+            if (record->section != SECTION_ADDITIONAL || record->type != type || record->rdlength != size ||
+                parse_domain_name(message->packet, message->len, record->name, owner) == -1) {
+                continue;
+            }
+
+            normalize_cache_key(key, owner);
+
+            for (int j = 0; j < ntargets; j++) {
+                if (strcmp(key, targets[j]) == 0) {
+                    make_server(trace->args, family, message->packet + record->rdata, &servers[nservers++]);
+                    break;
+                }
+            }
+        }
+    }
+
+    // Servers without glue, names inside the delegated zone cannot be resolved without it
+    for (int i = 0; i < ntargets && nservers == 0 && depth < MAX_TRACE_DEPTH; i++) {
+        if (!is_subdomain(targets[i], child)) {
+            trace_name(trace, targets[i], A, depth + 1, servers, &nservers);
+        }
+    }
+
+    if (nservers == 0) {
+        return -2;
+    }
+
+    return add_zone(trace, child, servers, nservers);
+}
+
+/**
+ * @brief Resolve a name iteratively.
+ *
+ * The resolution starts at the closest cached zone and follows referrals until a response that
+ * is not a referral is received. Steps of the queried name are printed, names of servers without
+ * glue are resolved silently and addresses of their final answers are stored.
+ *
+ * @param trace Pointer to the state of the iterative resolution.
+ * @param name Name to be queried.
+ * @param qtype Type of the query.
+ * @param depth Depth of the resolution (0 for the queried name).
+ * @param found Where addresses of the answer will be stored (up to MAX_SERVERS, depth > 0 only).
+ * @param nfound Number of stored addresses.
+ * @return 0 on success, otherwise an error code (see error.h).
+ */
+static int trace_name(trace_t* trace, const char* name, unsigned short qtype, int depth, dns_server_t* found, int* nfound) {
+    char key[MAX_NAME];
+    normalize_cache_key(key, name);
+
+    unsigned char* packet = malloc(MAX_BUFF);
+    dns_message_t* message = malloc(sizeof(dns_message_t));
+    if (packet == NULL || message == NULL) {
+        exit_error(E_EAI, strerror(errno));
+    }
+
+    int zone = find_zone(trace, key);
+    int err = E_TRACE;
+
+    for (int referrals = 0; referrals < MAX_REFERRALS; referrals++) {
+        trace_step_t step = { .packet = packet };
+
+        err = race_step(trace, zone, name, qtype, &step);
+        if (err) {
+            break;
+        }
+
+        if (depth == 0) {
+            err = print_step(trace, zone, &step);
+        }
+
+        if (parse_message(message, packet, step.len)) {
+            err = err ? err : E_TRACE;
+            break;
+        }
+
+        int next = follow_referral(trace, zone, key, message, depth);
+
+        if (next == -2) {
+            err = E_TRACE;
+            break;
+        }
+
+        // Final response, addresses of the answer are collected for servers without glue
+        if (next == -1) {
+            for (int i = 0; depth > 0 && i < message->nrecords && *nfound < MAX_SERVERS; i++) {
+                dns_record_t* record = &message->records[i];
+
+                if (record->section == SECTION_ANSWER && record->type == A && record->rdlength == sizeof(struct in_addr)) {
+                    make_server(trace->args, AF_INET, packet + record->rdata, &found[(*nfound)++]);
+                }
+            }
+            break;
+        }
+
+        zone = next;
+        err = E_TRACE;
+    }
+
+    free(packet);
+    free(message);
+
+    return err;
+}
+
+/**
+ * @brief Resolve the target address iteratively, starting at root servers.
+ *
+ * @param args Pointer to the program's command-line arguments.
+ * @param hints Root servers.
+ * @param nhints Number of root servers.
+ * @param capture Pointer to the capture of sent and received messages (NULL if disabled).
+ * @return 0 on success, otherwise an error code (see error.h).
+ */
+int run_trace(args_t* args, dns_server_t* hints, int nhints, capture_t* capture) {
+    trace_t trace = { .args = args, .capture = capture };
+    add_zone(&trace, ".", hints, nhints);
+
+    char name[MAX_NAME] = { 0 };
+    get_query_name(args, args->target_addr, name);
+
+    int err = trace_name(&trace, name, get_query_type(args), 0, NULL, NULL);
+
+    free(trace.zones);
+
+    return err;
+}
@@ -0,0 +1,59 @@
+/**
+ * @file trace.h
+ * @brief Iterative Resolution Header
+ *
+ * This C header file, "trace.h" declares the iterative resolution mode (`--trace`). The query is
+ * sent without recursion to the root servers (root hints) and NS referrals of the authority
+ * section are followed down to the authoritative servers of the name. Addresses of delegated
+ * servers are taken from glue records of the additional section, names of servers without glue
+ * are resolved iteratively as well. Delegations are cached, so every zone cut is asked only once.
+ *
+ * Every step is sent to up to TRACE_RACE servers of the zone at the same time and the first
+ * usable response wins, so the measured latency is the latency of the fastest authoritative
+ * server.
+ *
+ * @author Oleksandr Turytsia (xturyt00)
+ * @date October 18, 2023
+ */
+#ifndef TRACE_H
+#define TRACE_H
+
+#include "dns.h"
+#include "resolver.h"
+
+#define TRACE_RACE 3
+#define MAX_REFERRALS 16
+#define MAX_TRACE_DEPTH 4
+
+// Delegation (zone cut) known to the iterative resolver
+typedef struct {
+    char zone[MAX_NAME];            // Name of the zone (lowercase, without the trailing dot)
+    dns_server_t servers[MAX_SERVERS];  // Addresses of authoritative servers
+    int nservers;                   // Number of servers
+} trace_zone_t;
+
+// State of the iterative resolution
+typedef struct {
+    args_t* args;                   // Program arguments
+    capture_t* capture;             // Capture of sent and received messages (NULL if disabled)
+    trace_zone_t* zones;            // Cached delegations (the root zone first)
+    int nzones;                     // Number of cached delegations
+    int capacity;                   // Size of the delegation array
+    int step;                       // Number of printed steps
+} trace_t;
+
+// Result of a single step (the same query raced on several servers)
+typedef struct {
+    int done;                       // Usable response was received
+    int err;                        // Error of the last failed query
+    unsigned char* packet;          // Copy of the response (MAX_BUFF bytes)
+    int len;                        // Length of the response (0 if none)
+    int server;                     // Index of the server that answered
+    long long started;              // Time when the step started (us, CLOCK_MONOTONIC)
+    long long rtt;                  // Time of the response (us since the start)
+} trace_step_t;
+
+int load_root_hints(args_t* args, const char* path, dns_server_t* servers);
+int run_trace(args_t* args, dns_server_t* hints, int nhints, capture_t* capture);
+
+#endif
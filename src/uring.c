@@ -0,0 +1,310 @@
+/**
+ * @file uring.c
+ * @brief io_uring Ring Implementation
+ *
+ * This C source file, "uring.c" contains the implementation of a minimal io_uring ring. Rings
+ * are mapped into memory after `io_uring_setup`, entries are published to the kernel with release
+ * stores of the ring tails and consumed with acquire loads, as described in io_uring(7).
+ *
+ * @author Oleksandr Turytsia (xturyt00)
+ * @date October 18, 2023
+ */
+#include "uring.h"
+
+/**
+ * @brief Initialize a ring.
+ *
+ * @param ring Pointer to the ring.
+ * @param entries Number of submission queue entries (power of two).
+ * @param cq_entries Number of completion queue entries (power of two, at least `entries`).
+ * @return 0 on success, -1 if io_uring is not supported or the ring could not be mapped.
+ */
+int uring_init(uring_t* ring, unsigned entries, unsigned cq_entries) {
+    struct io_uring_params params;
+
+    memset(ring, 0, sizeof(uring_t));
+    memset(&params, 0, sizeof(params));
+    params.flags = IORING_SETUP_CQSIZE;
+    params.cq_entries = cq_entries;
+
+    ring->fd = syscall(__NR_io_uring_setup, entries, &params);
+    if (ring->fd < 0) {
+        ring->fd = -1;
+        return -1;
+    }
+
+    ring->sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    ring->cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    ring->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+
+    // Both rings share a single mapping on newer kernels
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        if (ring->cq_ring_size > ring->sq_ring_size) {
+            ring->sq_ring_size = ring->cq_ring_size;
+        }
+        ring->cq_ring_size = ring->sq_ring_size;
+    }
+
+    ring->sq_ring = mmap(NULL, ring->sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd,
+                         IORING_OFF_SQ_RING);
+    if (ring->sq_ring == MAP_FAILED) {
+        ring->sq_ring = NULL;
+        uring_free(ring);
+        return -1;
+    }
+
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        ring->cq_ring = ring->sq_ring;
+    }
+    else {
+        ring->cq_ring = mmap(NULL, ring->cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd,
+                             IORING_OFF_CQ_RING);
+        if (ring->cq_ring == MAP_FAILED) {
+            ring->cq_ring = NULL;
+            uring_free(ring);
+            return -1;
+        }
+    }
+
+    ring->sqes = mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd,
+                      IORING_OFF_SQES);
+    if (ring->sqes == MAP_FAILED) {
+        ring->sqes = NULL;
+        uring_free(ring);
+        return -1;
+    }
+
+    unsigned char* sq = ring->sq_ring;
+    ring->sq_head = (unsigned*)(sq + params.sq_off.head);
+    ring->sq_tail = (unsigned*)(sq + params.sq_off.tail);
+    ring->sq_mask = (unsigned*)(sq + params.sq_off.ring_mask);
+    ring->sq_array = (unsigned*)(sq + params.sq_off.array);
+    ring->sq_entries = params.sq_entries;
+    ring->sq_local = *ring->sq_tail;
+
+    unsigned char* cq = ring->cq_ring;
+    ring->cq_head = (unsigned*)(cq + params.cq_off.head);
+    ring->cq_tail = (unsigned*)(cq + params.cq_off.tail);
+    ring->cq_mask = (unsigned*)(cq + params.cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe*)(cq + params.cq_off.cqes);
+
+    // Submission queue entries are used in order
+    for (unsigned i = 0; i < ring->sq_entries; i++) {
+        ring->sq_array[i] = i;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Check whether the kernel supports operations.
+ *
+ * @param ring Pointer to the ring.
+ * @param ops Operations (IORING_OP_*).
+ * @param nops Number of operations.
+ * @return 1 if all operations are supported, 0 otherwise.
+ */
+int uring_supports(uring_t* ring, const int* ops, int nops) {
+    size_t size = sizeof(struct io_uring_probe) + 256 * sizeof(struct io_uring_probe_op);
+    struct io_uring_probe* probe = calloc(1, size);
+    if (probe == NULL) {
+        return 0;
+    }
+
+    int supported = syscall(__NR_io_uring_register, ring->fd, IORING_REGISTER_PROBE, probe, 256) == 0;
+
+    for (int i = 0; supported && i < nops; i++) {
+        supported = ops[i] <= probe->last_op && (probe->ops[ops[i]].flags & IO_URING_OP_SUPPORTED);
+    }
+
+    free(probe);
+
+    return supported;
+}
+
+/**
+ * @brief Register a buffer for fixed buffer operations (buffer index 0).
+ *
+ * @param ring Pointer to the ring.
+ * @param base Start of the buffer.
+ * @param len Length of the buffer.
+ * @return 0 on success, -1 on failure (errno is set).
+ */
+int uring_register_buffer(uring_t* ring, void* base, size_t len) {
+    struct iovec iov = { .iov_base = base, .iov_len = len };
+
+    return syscall(__NR_io_uring_register, ring->fd, IORING_REGISTER_BUFFERS, &iov, 1) == 0 ? 0 : -1;
+}
+
+/**
+ * @brief Set up a provided buffer ring, that is used by requests with IOSQE_BUFFER_SELECT.
+ *
+ * @param ring Pointer to the ring.
+ * @param entries Number of buffers (power of two).
+ * @param group Identifier of the buffer group.
+ * @return 0 on success, -1 on failure.
+ */
+int uring_setup_buf_ring(uring_t* ring, unsigned entries, unsigned short group) {
+    ring->buf_ring_size = entries * sizeof(struct io_uring_buf);
+    ring->buf_ring = mmap(NULL, ring->buf_ring_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (ring->buf_ring == MAP_FAILED) {
+        ring->buf_ring = NULL;
+        return -1;
+    }
+
+    struct io_uring_buf_reg reg;
+    memset(&reg, 0, sizeof(reg));
+    reg.ring_addr = (unsigned long)ring->buf_ring;
+    reg.ring_entries = entries;
+    reg.bgid = group;
+
+    if (syscall(__NR_io_uring_register, ring->fd, IORING_REGISTER_PBUF_RING, &reg, 1) != 0) {
+        munmap(ring->buf_ring, ring->buf_ring_size);
+        ring->buf_ring = NULL;
+        return -1;
+    }
+
+    ring->buf_entries = entries;
+
+    return 0;
+}
+
+/**
+ * @brief Give a buffer to the provided buffer ring.
+ *
+ * @param ring Pointer to the ring.
+ * @param addr Start of the buffer.
+ * @param len Length of the buffer.
+ * @param bid Identifier of the buffer (reported in completions).
+ */
+void uring_provide_buffer(uring_t* ring, void* addr, unsigned len, unsigned short bid) {
+    unsigned short tail = ring->buf_ring->tail;
+    struct io_uring_buf* buf = &ring->buf_ring->bufs[tail & (ring->buf_entries - 1)];
+
+    // Reserved field of the first entry is the tail, so fields are set one by one
+    buf->addr = (unsigned long)addr;
+    buf->len = len;
+    buf->bid = bid;
+
+    __atomic_store_n(&ring->buf_ring->tail, (unsigned short)(tail + 1), __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief Get a free submission queue entry.
+ *
+ * If the submission queue is full, prepared entries are submitted first.
+ *
+ * @param ring Pointer to the ring.
+ * @return Zeroed entry, or NULL if the submission queue is full.
+ */
+struct io_uring_sqe* uring_get_sqe(uring_t* ring) {
+    if (ring->sq_local - __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE) >= ring->sq_entries) {
+        uring_submit(ring);
+
+        if (ring->sq_local - __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE) >= ring->sq_entries) {
+            return NULL;
+        }
+    }
+
+    struct io_uring_sqe* sqe = &ring->sqes[ring->sq_local & *ring->sq_mask];
+    memset(sqe, 0, sizeof(struct io_uring_sqe));
+    ring->sq_local++;
+
+    return sqe;
+}
+
+/**
+ * @brief Submit prepared entries to the kernel.
+ *
+ * @param ring Pointer to the ring.
+ * @return Number of submitted entries, or -1 on failure (errno is set).
+ */
+int uring_submit(uring_t* ring) {
+    // Entries published earlier may be left unconsumed by a failed submission
+    unsigned pending = ring->sq_local - __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE);
+    if (pending == 0) {
+        return 0;
+    }
+
+    __atomic_store_n(ring->sq_tail, ring->sq_local, __ATOMIC_RELEASE);
+
+    return syscall(__NR_io_uring_enter, ring->fd, pending, 0, 0, NULL, 0);
+}
+
+/**
+ * @brief Withdraw prepared entries that were not consumed by the kernel.
+ *
+ * Used after a failed submission, only the most recently prepared entries are withdrawn, so
+ * entries left by earlier submissions are kept.
+ *
+ * @param ring Pointer to the ring.
+ * @param count Maximum number of entries to withdraw.
+ * @return Number of withdrawn entries.
+ */
+unsigned uring_withdraw(uring_t* ring, unsigned count) {
+    unsigned pending = ring->sq_local - __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE);
+    if (count > pending) {
+        count = pending;
+    }
+
+    // Kernel reads the tail only when entries are submitted (the ring is not polled)
+    ring->sq_local -= count;
+    __atomic_store_n(ring->sq_tail, ring->sq_local, __ATOMIC_RELEASE);
+
+    return count;
+}
+
+/**
+ * @brief Get the next completion without waiting.
+ *
+ * @param ring Pointer to the ring.
+ * @return Completion queue entry, or NULL if there is none.
+ */
+struct io_uring_cqe* uring_peek_cqe(uring_t* ring) {
+    unsigned head = *ring->cq_head;
+
+    if (head == __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE)) {
+        return NULL;
+    }
+
+    return &ring->cqes[head & *ring->cq_mask];
+}
+
+/**
+ * @brief Mark the completion returned by `uring_peek_cqe` as consumed.
+ *
+ * @param ring Pointer to the ring.
+ */
+void uring_cqe_seen(uring_t* ring) {
+    __atomic_store_n(ring->cq_head, *ring->cq_head + 1, __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief Free resources of the ring (outstanding requests are cancelled).
+ *
+ * @param ring Pointer to the ring.
+ */
+void uring_free(uring_t* ring) {
+    if (ring->fd != -1) {
+        close(ring->fd);
+    }
+
+    if (ring->buf_ring != NULL) {
+        munmap(ring->buf_ring, ring->buf_ring_size);
+    }
+
+    if (ring->sqes != NULL) {
+        munmap(ring->sqes, ring->sqes_size);
+    }
+
+    if (ring->cq_ring != NULL && ring->cq_ring != ring->sq_ring) {
+        munmap(ring->cq_ring, ring->cq_ring_size);
+    }
+
+    if (ring->sq_ring != NULL) {
+        munmap(ring->sq_ring, ring->sq_ring_size);
+    }
+
+    memset(ring, 0, sizeof(uring_t));
+    ring->fd = -1;
+}
@@ -0,0 +1,63 @@
+/**
+ * @file uring.h
+ * @brief io_uring Ring Header
+ *
+ * This C header file, "uring.h" defines a minimal io_uring ring built directly on the
+ * `io_uring_setup`, `io_uring_enter` and `io_uring_register` system calls (no liburing). It
+ * provides submission and completion of requests, registered buffers, a provided buffer ring
+ * for multishot receives and probing of supported operations.
+ *
+ * @author Oleksandr Turytsia (xturyt00)
+ * @date October 18, 2023
+ */
+#ifndef URING_H
+#define URING_H
+
+#include "libs.h"
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+
+#define URING_ENTRIES 256
+#define URING_BUFFERS 256
+
+// io_uring instance
+typedef struct {
+    int fd;                         // File descriptor of the ring (-1 if not set up)
+
+    unsigned* sq_head;              // Submission queue (shared with the kernel)
+    unsigned* sq_tail;
+    unsigned* sq_mask;
+    unsigned* sq_array;
+    unsigned sq_entries;            // Number of submission queue entries
+    unsigned sq_local;              // Tail including entries not yet published to the kernel
+    struct io_uring_sqe* sqes;      // Submission queue entries
+
+    unsigned* cq_head;              // Completion queue (shared with the kernel)
+    unsigned* cq_tail;
+    unsigned* cq_mask;
+    struct io_uring_cqe* cqes;      // Completion queue entries
+
+    void* sq_ring;                  // Mapped rings
+    size_t sq_ring_size;
+    void* cq_ring;
+    size_t cq_ring_size;
+    size_t sqes_size;
+
+    struct io_uring_buf_ring* buf_ring;  // Provided buffer ring (NULL if not set up)
+    size_t buf_ring_size;
+    unsigned buf_entries;           // Number of entries of the buffer ring
+} uring_t;
+
+int uring_init(uring_t* ring, unsigned entries, unsigned cq_entries);
+int uring_supports(uring_t* ring, const int* ops, int nops);
+int uring_register_buffer(uring_t* ring, void* base, size_t len);
+int uring_setup_buf_ring(uring_t* ring, unsigned entries, unsigned short group);
+void uring_provide_buffer(uring_t* ring, void* addr, unsigned len, unsigned short bid);
+struct io_uring_sqe* uring_get_sqe(uring_t* ring);
+int uring_submit(uring_t* ring);
+unsigned uring_withdraw(uring_t* ring, unsigned count);
+struct io_uring_cqe* uring_peek_cqe(uring_t* ring);
+void uring_cqe_seen(uring_t* ring);
+void uring_free(uring_t* ring);
+
+#endif
@@ -9,13 +9,15 @@
  * The file defines and provides the following utility functions:
  * - `const char* get_dns_class(unsigned short class)`: Returns the DNS class name for a given class code, or "Not supported" if invalid.
  * - `const char* get_dns_type(unsigned short type)`: Returns the DNS type name for a given type code, or "Not supported" if invalid.
+ * - `unsigned short get_dns_type_value(const char* name)`: Returns the type code of a DNS type name, or 0 if unknown.
  * - `void print_packet(unsigned char* packet, int len)`: Prints a formatted representation of a DNS packet for debugging.
  * - `const char* bool_to_yes_no(int value)`: Converts a boolean value to a "Yes" or "No" string.
  * - `int get_name_length(unsigned char* pointer_to_name, char* name)`: Determines the length of a DNS domain name.
  * - `int is_type_valid(unsigned short type)`: Checks if a DNS type is valid.
  * - `int is_class_valid(unsigned short type)`: Checks if a DNS class is valid.
  *
- * The file also defines arrays (`type_names` and `class_names`) to map DNS type and class codes to their string representations.
+ * The file also defines the array `class_names` to map DNS class codes to their string representations, names of types
+ * are taken from the registry of record types (see rdata.h).
  *
  * These utility functions provide essential functionality for parsing, displaying, and validating DNS-related data in the DNS
  * query program. They contribute to the overall robustness of the program and facilitate easier debugging and interpretation
@@ -25,26 +27,7 @@
  * @date October 18, 2023
  */
 #include "utils.h"
-
-const char* type_names[] = {
-    [A] = "A",
-    [NS] = "NS",
-    [MD] = "MD",
-    [MF] = "MF",
-    [CNAME] = "CNAME",
-    [SOA] = "SOA",
-    [MB] = "MB",
-    [MG] = "MG",
-    [MR] = "MR",
-    [NIL] = "NIL",
-    [WKS] = "WKS",
-    [PTR] = "PTR",
-    [HINFO] = "HINFO",
-    [MINFO] = "MINFO",
-    [MX] = "MX",
-    [TXT] = "TXT",
-    [AAAA] = "AAAA"
-};
+#include "rdata.h"
 
 const char* class_names[] = {
     [IN] = "IN",
@@ -57,34 +40,31 @@ const char* class_names[] = {
  * @brief Check if a DNS resource record type is valid.
  *
  * This function checks whether a DNS resource record type, represented as an unsigned short 'type',
- * is valid or not. It returns 1 if the type is valid, based on a predefined set of valid types, and 0 if it's not.
+ * is valid or not. It returns 1 if the type is in the registry of record types (see rdata.h), and 0 if it's not.
  *
  * @param type The DNS resource record type as an unsigned short.
  * @return 1 if the type is valid, 0 otherwise.
  */
 int is_type_valid(unsigned short type) {
-    switch(type){
-        case A:
-        case NS:
-        case MD:
-        case MF:
-        case CNAME:
-        case SOA:
-        case MB:
-        case MG:
-        case MR:
-        case NIL:
-        case WKS:
-        case PTR:
-        case HINFO:
-        case MINFO:
-        case MX:
-        case TXT:
-        case AAAA:
-            return 1;
-        default:
-            return 0;
+    return get_rdata_type(type) != NULL;
+}
+
+/**
+ * @brief Get the type code of a DNS type name.
+ *
+ * Names are compared case-insensitively. The OPT pseudo-type is not a queryable type.
+ *
+ * @param name Name of the type (e.g. "MX").
+ * @return Type code, or 0 if the name is not a known type.
+ */
+unsigned short get_dns_type_value(const char* name) {
+    for (unsigned short type = A; type < RDATA_TYPES; type++) {
+        if (type != OPT && is_type_valid(type) && strcasecmp(get_rdata_type(type)->name, name) == 0) {
+            return type;
+        }
     }
+
+    return 0;
 }
 
 /**
@@ -137,10 +117,11 @@ const char* get_dns_class(unsigned short class) {
  * @return A string representing the DNS type or "Not supported" for invalid types.
  */
 const char* get_dns_type(unsigned short type) {
-    if(!is_type_valid(type))
+    const rdata_type_t* rdata_type = get_rdata_type(type);
+    if (rdata_type == NULL)
         return "Not supported";
 
-    return type_names[type];
+    return rdata_type->name;
 }
 
 /**
@@ -46,7 +46,10 @@ typedef enum {
     MINFO,
     MX,
     TXT,
-    AAAA = 28
+    AAAA = 28,
+    SRV = 33,
+    OPT = 41,
+    CAA = 257
 } type_t;
 
 typedef enum {
@@ -66,6 +69,7 @@ typedef enum {
 
 const char* get_dns_class(unsigned short class);
 const char* get_dns_type(unsigned short type);
+unsigned short get_dns_type_value(const char* name);
 void print_packet(unsigned char* packet, int len);
 const char* bool_to_yes_no(int value);
 int get_name_length(unsigned char* pointer_to_name, char* name);
@@ -0,0 +1,170 @@
+/**
+ * @file writer.c
+ * @brief Buffered Writer Implementation
+ *
+ * This C source file, "writer.c" contains the implementation of the buffered writer. Numbers and
+ * JSON strings are formatted straight into the buffer without `printf`.
+ *
+ * @author Oleksandr Turytsia (xturyt00)
+ * @date October 18, 2023
+ */
+#include "writer.h"
+
+/**
+ * @brief Initialize a writer.
+ *
+ * @param writer Pointer to the writer.
+ * @param fd Output file descriptor.
+ * @param cap Size of the buffer.
+ * @return 0 on success, -1 if memory could not be allocated.
+ */
+int writer_init(writer_t* writer, int fd, int cap) {
+    writer->fd = fd;
+    writer->len = 0;
+    writer->cap = cap;
+    writer->buf = malloc(cap);
+
+    return writer->buf == NULL ? -1 : 0;
+}
+
+/**
+ * @brief Write all bytes to the file descriptor.
+ *
+ * @param fd Output file descriptor.
+ * @param data Bytes to be written.
+ * @param len Number of bytes.
+ */
+static void write_all(int fd, const char* data, int len) {
+    while (len > 0) {
+        ssize_t n = write(fd, data, len);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return;
+        }
+
+        data += n;
+        len -= n;
+    }
+}
+
+/**
+ * @brief Write bytes.
+ *
+ * @param writer Pointer to the writer.
+ * @param data Bytes to be written.
+ * @param len Number of bytes.
+ */
+void writer_write(writer_t* writer, const void* data, int len) {
+    if (writer->len + len > writer->cap) {
+        writer_flush(writer);
+
+        // Larger than the whole buffer
+        if (len > writer->cap) {
+            write_all(writer->fd, data, len);
+            return;
+        }
+    }
+
+    memcpy(writer->buf + writer->len, data, len);
+    writer->len += len;
+}
+
+/**
+ * @brief Write a string.
+ *
+ * @param writer Pointer to the writer.
+ * @param str String to be written.
+ */
+void writer_puts(writer_t* writer, const char* str) {
+    writer_write(writer, str, strlen(str));
+}
+
+/**
+ * @brief Write a character.
+ *
+ * @param writer Pointer to the writer.
+ * @param c Character to be written.
+ */
+void writer_char(writer_t* writer, char c) {
+    if (writer->len == writer->cap) {
+        writer_flush(writer);
+    }
+
+    writer->buf[writer->len++] = c;
+}
+
+/**
+ * @brief Write an unsigned number in decimal.
+ *
+ * @param writer Pointer to the writer.
+ * @param value Number to be written.
+ */
+void writer_uint(writer_t* writer, unsigned long long value) {
+    char digits[20];
+    int n = sizeof(digits);
+
+    do {
+        digits[--n] = '0' + value % 10;
+        value /= 10;
+    } while (value != 0);
+
+    writer_write(writer, digits + n, sizeof(digits) - n);
+}
+
+/**
+ * @brief Write a string as a quoted JSON string.
+ *
+ * Quotes, backslashes, control characters and bytes outside of ASCII are escaped, so the output
+ * is valid JSON for any name found in a packet.
+ *
+ * @param writer Pointer to the writer.
+ * @param str String to be written.
+ */
+void writer_json_string(writer_t* writer, const char* str) {
+    static const char hex[] = "0123456789abcdef";
+
+    writer_char(writer, '"');
+
+    for (const unsigned char* c = (const unsigned char*)str; *c != 0; c++) {
+        if (*c == '"' || *c == '\\') {
+            writer_char(writer, '\\');
+            writer_char(writer, *c);
+        }
+        else if (*c < 0x20 || *c >= 0x7F) {
+            char escape[] = { '\\', 'u', '0', '0', hex[*c >> 4], hex[*c & 0x0F] };
+            writer_write(writer, escape, sizeof(escape));
+        }
+        else {
+            writer_char(writer, *c);
+        }
+    }
+
+    writer_char(writer, '"');
+}
+
+/**
+ * @brief Write all buffered bytes to the file descriptor.
+ *
+ * @param writer Pointer to the writer.
+ */
+void writer_flush(writer_t* writer) {
+    write_all(writer->fd, writer->buf, writer->len);
+    writer->len = 0;
+}
+
+/**
+ * @brief Flush the writer and free its buffer.
+ *
+ * @param writer Pointer to the writer (NULL if not used).
+ */
+void writer_free(writer_t* writer) {
+    if (writer == NULL) {
+        return;
+    }
+
+    writer_flush(writer);
+    free(writer->buf);
+    writer->buf = NULL;
+}
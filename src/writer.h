@@ -0,0 +1,35 @@
+/**
+ * @file writer.h
+ * @brief Buffered Writer Header
+ *
+ * This C header file, "writer.h" defines a buffered writer of a file descriptor. Output is
+ * collected in a large buffer and written by a single `write` call once the buffer is full, so
+ * formatting many small fields does not cost a call into the C library or the kernel per field.
+ *
+ * @author Oleksandr Turytsia (xturyt00)
+ * @date October 18, 2023
+ */
+#ifndef WRITER_H
+#define WRITER_H
+
+#include "libs.h"
+
+#define WRITER_SIZE (1 << 20)
+
+typedef struct {
+    int fd;                         // Output file descriptor
+    char* buf;                      // Buffered output
+    int len;                        // Number of buffered bytes
+    int cap;                        // Size of the buffer
+} writer_t;
+
+int writer_init(writer_t* writer, int fd, int cap);
+void writer_write(writer_t* writer, const void* data, int len);
+void writer_puts(writer_t* writer, const char* str);
+void writer_char(writer_t* writer, char c);
+void writer_uint(writer_t* writer, unsigned long long value);
+void writer_json_string(writer_t* writer, const char* str);
+void writer_flush(writer_t* writer);
+void writer_free(writer_t* writer);
+
+#endif
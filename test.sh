@@ -6,9 +6,28 @@
 # Date: October 25, 2023
 # Usage: ./test.sh
 TEST_PATH="./tests"
+ZONE_PATH="$TEST_PATH/zones"
+ZONE_PORT=5400
 
 make
 
+# Fake zones of the --trace tests, every server has its own loopback address
+zone_pids=()
+start_zone() {
+    python3 "$ZONE_PATH/fakezone.py" "$1" $ZONE_PORT "$ZONE_PATH/$2.zone" $3 &
+    zone_pids+=($!)
+}
+
+start_zone 127.0.0.10 root
+start_zone 127.0.0.11 com 0.3
+start_zone 127.0.0.12 com
+start_zone 127.0.0.13 net
+start_zone 127.0.0.14 example
+start_zone 127.0.0.15 hoster
+start_zone 127.0.0.16 noglue
+start_zone 127.0.0.17 example 0.3
+sleep 1
+
 for file in "$TEST_PATH"/*.in; do
     file_name=$(basename "$file" .in)
 
@@ -23,4 +42,38 @@ for file in "$TEST_PATH"/*.in; do
     fi
 done
 
+# Caching forwarder of the --listen tests (queries are sent by tests/zones/client.py), queries
+# forwarded to its upstream server are captured and compared with listen/upstream.out
+LISTEN_PORT=5401
+LISTEN_CAPTURE=$(mktemp)
+./dns -s 127.0.0.17 -p $ZONE_PORT --listen 127.0.0.1 --listen-port $LISTEN_PORT --pcap-out "$LISTEN_CAPTURE" &
+listen_pid=$!
+sleep 1
+
+for file in "$TEST_PATH"/listen/*.in; do
+    file_name=$(basename "$file" .in)
+
+    args=$(cat ./$TEST_PATH/listen/$file_name.in)
+
+    out=$(python3 "$ZONE_PATH/client.py" 127.0.0.1 $LISTEN_PORT $args 2>&1)
+
+    if diff -u ./$TEST_PATH/listen/$file_name.out <(echo "$out"); then
+        echo "Test Passed: Output listen/$file_name.in matches the expected result."
+    else
+        echo "Test Failed: Output listen/$file_name.in does not match the expected result."
+    fi
+done
+
+kill $listen_pid
+wait $listen_pid 2>/dev/null
+
+if diff -u ./$TEST_PATH/listen/upstream.out <(./dns -t --pcap-in "$LISTEN_CAPTURE" 2>&1); then
+    echo "Test Passed: Output listen/upstream.out matches the forwarded queries."
+else
+    echo "Test Failed: Output listen/upstream.out does not match the forwarded queries."
+fi
+rm -f "$LISTEN_CAPTURE"
+
+kill "${zone_pids[@]}" 2>/dev/null
+
 make clean
@@ -0,0 +1,108 @@
+#!/usr/bin/env python3
+#
+# Script Name: client.py
+# Description: DNS client (UDP) of the --listen tests, sends raw queries to the caching forwarder
+# Author: Oleksandr Turytsia
+# Date: October 25, 2023
+# Usage: ./client.py address port [--together] query...
+#
+# Every query is "name:type" (a standard query with the RD flag), "malformed" (a question with
+# a label longer than the packet) or "qdcount2" (two questions). Queries are identified by their
+# position (starting at 1). Without --together, every query waits for its response before the next
+# one is sent, otherwise all of them are sent at once. Responses are printed in the order of queries
+# as "Response (N): RCODE, questions: Q" followed by the A records of the answer section.
+import socket
+import struct
+import sys
+
+TYPES = {'A': 1, 'NS': 2, 'CNAME': 5, 'SOA': 6, 'AAAA': 28}
+RCODES = ['NOERROR', 'FORMERR', 'SERVFAIL', 'NXDOMAIN', 'NOTIMP', 'REFUSED']
+
+
+def encode_name(name):
+    out = b''
+    for label in name.rstrip('.').split('.'):
+        if label:
+            out += bytes([len(label)]) + label.encode()
+    return out + b'\0'
+
+
+def decode_name(packet, offset):
+    labels = []
+    end = None
+    while packet[offset] != 0:
+        if packet[offset] & 0xC0 == 0xC0:
+            end = end or offset + 2
+            offset = struct.unpack('!H', packet[offset:offset + 2])[0] & 0x3FFF
+            continue
+        length = packet[offset]
+        labels.append(packet[offset + 1:offset + 1 + length].decode())
+        offset += 1 + length
+    return '.'.join(labels) + '.', end or offset + 1
+
+
+def build_query(qid, query):
+    if query == 'malformed':
+        return struct.pack('!HHHHHH', qid, 0x0100, 1, 0, 0, 0) + b'\x3fwww'
+    if query == 'qdcount2':
+        question = encode_name('www.example.com') + struct.pack('!HH', 1, 1)
+        return struct.pack('!HHHHHH', qid, 0x0100, 2, 0, 0, 0) + question * 2
+    name, qtype = query.split(':')
+    return struct.pack('!HHHHHH', qid, 0x0100, 1, 0, 0, 0) + encode_name(name) + struct.pack('!HH', TYPES[qtype], 1)
+
+
+def describe(packet):
+    _, flags, qdcount, ancount = struct.unpack('!HHHH', packet[:8])
+    lines = ['%s, questions: %d' % (RCODES[flags & 0xF], qdcount)]
+
+    offset = 12
+    for _ in range(qdcount):
+        offset = decode_name(packet, offset)[1] + 4
+
+    for _ in range(ancount):
+        name, offset = decode_name(packet, offset)
+        rtype, _, _, rdlength = struct.unpack('!HHIH', packet[offset:offset + 10])
+        offset += 10
+        if rtype == TYPES['A']:
+            lines.append(' %s A %s' % (name, socket.inet_ntop(socket.AF_INET, packet[offset:offset + 4])))
+        offset += rdlength
+    return lines
+
+
+def main():
+    address, port = sys.argv[1], int(sys.argv[2])
+    together = '--together' in sys.argv[3:]
+    queries = [arg for arg in sys.argv[3:] if arg != '--together']
+
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    sock.settimeout(2)
+    responses = {}
+
+    def receive():
+        try:
+            packet = sock.recv(65535)
+            responses[struct.unpack('!H', packet[:2])[0]] = packet
+        except socket.timeout:
+            return False
+        return True
+
+    for qid, query in enumerate(queries, 1):
+        sock.sendto(build_query(qid, query), (address, port))
+        if not together and not receive():
+            break
+
+    while together and len(responses) < len(queries) and receive():
+        pass
+
+    for qid in range(1, len(queries) + 1):
+        if qid not in responses:
+            print('Response (%d): timeout' % qid)
+            continue
+        lines = describe(responses[qid])
+        print('Response (%d): %s' % (qid, lines[0]))
+        for line in lines[1:]:
+            print(line)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,149 @@
+#!/usr/bin/env python3
+#
+# Script Name: fakezone.py
+# Description: Fake authoritative DNS server (UDP) of a single zone, used by the --trace tests
+# Author: Oleksandr Turytsia
+# Date: October 25, 2023
+# Usage: ./fakezone.py address port zonefile [delay]
+#
+# Zone files have one record per line: "name type value...". Supported types are A, AAAA, NS,
+# CNAME and SOA, the owner of the SOA record is the origin of the zone. NS records of names below
+# the origin are delegations, queries for names below them are answered by a referral with glue
+# (A/AAAA records of the zone for the names of the servers). CNAME records are followed within the
+# zone (RFC 1034 4.3.2), targets outside of the origin are left to the client. A "name SERVFAIL type"
+# line makes queries of the type for the name fail. Responses of a server with a delay are sent
+# after the delay, so races between servers of a zone are decided deterministically.
+import socket
+import struct
+import sys
+import time
+
+TYPES = {'A': 1, 'NS': 2, 'CNAME': 5, 'SOA': 6, 'AAAA': 28}
+
+
+def encode_name(name):
+    out = b''
+    for label in name.rstrip('.').split('.'):
+        if label:
+            out += bytes([len(label)]) + label.encode()
+    return out + b'\0'
+
+
+def decode_name(packet, offset):
+    labels = []
+    while packet[offset] != 0:
+        length = packet[offset]
+        labels.append(packet[offset + 1:offset + 1 + length].decode().lower())
+        offset += 1 + length
+    return '.'.join(labels) + '.', offset + 1
+
+
+def encode_rdata(rtype, value):
+    if rtype == 'A':
+        return socket.inet_pton(socket.AF_INET, value[0])
+    if rtype == 'AAAA':
+        return socket.inet_pton(socket.AF_INET6, value[0])
+    if rtype in ('NS', 'CNAME'):
+        return encode_name(value[0])
+    return encode_name(value[0]) + encode_name(value[1]) + struct.pack('!IIIII', *map(int, value[2:7]))
+
+
+def encode_rr(name, rtype, value, ttl=3600):
+    rdata = encode_rdata(rtype, value)
+    return encode_name(name) + struct.pack('!HHIH', TYPES[rtype], 1, ttl, len(rdata)) + rdata
+
+
+def load_zone(path):
+    records = {}
+    origin = None
+    with open(path) as zone:
+        for line in zone:
+            fields = line.split()
+            if not fields or fields[0].startswith(';'):
+                continue
+            name = fields[0].lower()
+            records.setdefault(name, []).append((fields[1], fields[2:]))
+            if fields[1] == 'SOA':
+                origin = name
+    return origin, records
+
+
+def is_below(name, zone):
+    return zone == '.' or name == zone or name.endswith('.' + zone)
+
+
+def answer(query, origin, records):
+    qid, flags = struct.unpack('!HH', query[:4])
+    name, offset = decode_name(query, 12)
+    qtype = struct.unpack('!H', query[offset:offset + 2])[0]
+    question = query[12:offset + 4]
+
+    # Closest delegation below the origin
+    cut = None
+    for owner, rrs in records.items():
+        if owner != origin and is_below(name, owner) and any(rtype == 'NS' for rtype, _ in rrs):
+            if cut is None or len(owner) > len(cut):
+                cut = owner
+
+    answers, authority, additional = [], [], []
+    aa, rcode = 1, 0
+
+    if cut is not None:
+        aa = 0
+        for rtype, value in records[cut]:
+            if rtype == 'NS':
+                authority.append(encode_rr(cut, 'NS', value))
+                for glue_type, glue in records.get(value[0].lower(), []):
+                    if glue_type in ('A', 'AAAA'):
+                        additional.append(encode_rr(value[0], glue_type, glue))
+    elif name in records:
+        owner, visited = name, set()
+        while owner in records and owner not in visited:
+            visited.add(owner)
+            target = None
+            for rtype, value in records[owner]:
+                if rtype == 'SERVFAIL':
+                    rcode = 2 if TYPES[value[0]] == qtype else rcode
+                elif TYPES[rtype] == qtype or rtype == 'CNAME':
+                    answers.append(encode_rr(owner, rtype, value))
+                    target = value[0].lower() if rtype == 'CNAME' else target
+            if target is None or not is_below(target, origin):
+                break
+            owner = target
+        if rcode:
+            answers = []
+    else:
+        rcode = 3
+
+    if not answers and cut is None and rcode != 2:
+        for rtype, value in records[origin]:
+            if rtype == 'SOA':
+                authority.append(encode_rr(origin, 'SOA', value))
+
+    header = struct.pack('!HHHHHH', qid, 0x8000 | (aa << 10) | (flags & 0x0100) | rcode, 1,
+                         len(answers), len(authority), len(additional))
+    return header + question + b''.join(answers + authority + additional)
+
+
+def main():
+    address, port, path = sys.argv[1], int(sys.argv[2]), sys.argv[3]
+    delay = float(sys.argv[4]) if len(sys.argv) > 4 else 0.0
+    origin, records = load_zone(path)
+
+    sock = socket.socket(socket.AF_INET6 if ':' in address else socket.AF_INET, socket.SOCK_DGRAM)
+    sock.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+    sock.bind((address, port))
+
+    while True:
+        query, client = sock.recvfrom(65535)
+        try:
+            response = answer(query, origin, records)
+        except (IndexError, KeyError, UnicodeDecodeError, struct.error):
+            continue
+        if delay:
+            time.sleep(delay)
+        sock.sendto(response, client)
+
+
+if __name__ == '__main__':
+    main()